@@ -0,0 +1,624 @@
+/**
+*
+* \file bench.cpp
+* \brief Benchmarks for the Cstar routines
+* \ingroup CSTAR
+*
+*  Times every routine in double and in dvariable mode over vector lengths
+*  from 10 to 10^5 and writes one CSV line per (routine, mode, length):
+*
+*    routine,mode,n,reps,ns_per_element,stack_bytes,reverse_ns_per_element
+*
+*  stack_bytes is the gradient stack and derivative buffer written by one
+*  call, and reverse_ns_per_element the time gradcalc() takes to sweep it
+*  back (zero in double mode). Build and run with 'make bench' in src/.
+*
+*  Usage: cstar_bench [name-filter] [max-length]
+*         cstar_bench check
+*
+*  'check' instead compares the fused and vectorized routines with the
+*  ones they stand in for and exits non-zero if any error is out of
+*  tolerance ('make check' in src/).
+*
+* \date 10/18/2026
+*
+ */
+
+#include <admodel.h>
+#include "cstar.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// =========================================================================================================
+// Data shared by the benchmarks for one vector length
+// =========================================================================================================
+
+struct BenchData
+{
+    int n;
+    dvector x;          // size classes 1..n
+    dvector xout;       // output points inside the range of x
+    dvector y;          // a smooth curve on x
+    dvector obs;        // counts
+    dvector prop;       // observed proportions
+    dvector pred;       // predicted proportions
+    dvector mu;         // predicted counts
+    ApproxTable table;  // stencils for xout on x
+
+    explicit BenchData(int nn) : n(nn)
+    {
+        x.allocate(1,n);
+        xout.allocate(1,n);
+        y.allocate(1,n);
+        obs.allocate(1,n);
+        prop.allocate(1,n);
+        pred.allocate(1,n);
+        mu.allocate(1,n);
+        for(int i = 1; i <= n; i++)
+        {
+            x(i)    = i;
+            xout(i) = 1. + (n - 1.5) * (i - 0.5) / n;
+            y(i)    = 2. + sin(0.1 * i);
+            mu(i)   = 5. + 3. * sin(0.37 * i) * sin(0.37 * i);
+            obs(i)  = floor(mu(i) + 2. * cos(0.71 * i));
+            pred(i) = mu(i);
+        }
+        prop = obs / sum(obs);
+        pred = pred / sum(pred);
+        table.Set_x(x);
+        table.Set_xout(xout);
+    }
+};
+
+// =========================================================================================================
+// Benchmark cases: a double run, and a dvariable run on the independent variables p
+// =========================================================================================================
+
+typedef std::function<dvector(const BenchData&)>                     InitFn;
+typedef std::function<double(const BenchData&)>                      DoubleFn;
+typedef std::function<dvariable(const dvar_vector&, const BenchData&)> DvarFn;
+
+struct BenchCase
+{
+    const char *name;
+    InitFn      init;      // starting values of the independent variables
+    DoubleFn    run_double;
+    DvarFn      run_dvar;
+};
+
+static dvector scalars(double a, double b, double c = 0.)
+{
+    dvector v(1,3);
+    v(1) = a;
+    v(2) = b;
+    v(3) = c;
+    return v;
+}
+
+static std::vector<BenchCase> bench_cases()
+{
+    std::vector<BenchCase> cases;
+    InitFn curve = [](const BenchData& D) { return dvector(D.y); };
+
+    cases.push_back(BenchCase{"approx", curve,
+        [](const BenchData& D) { return sum(approx(D.xout, D.x, D.y)); },
+        [](const dvar_vector& p, const BenchData& D) { return sum(approx(D.xout, D.x, p)); }});
+
+    cases.push_back(BenchCase{"linapprox", curve,
+        [](const BenchData& D) { Selex s; return sum(s.linapprox(D.x, D.y, D.xout)); },
+        [](const dvar_vector& p, const BenchData& D) { Selex s; return sum(s.linapprox(D.x, p, D.xout)); }});
+
+    cases.push_back(BenchCase{"linapprox_table", curve,
+        [](const BenchData& D) { Selex s; return sum(s.linapprox(D.table, D.y)); },
+        [](const dvar_vector& p, const BenchData& D) { Selex s; return sum(s.linapprox(D.table, p)); }});
+
+    cases.push_back(BenchCase{"LogisticCurve",
+        [](const BenchData& D) { return scalars(0.5 * D.n, 0.1 * D.n); },
+        [](const BenchData& D)
+        {
+            cstar::LogisticCurve<dvector,double> c(0.5 * D.n, 0.1 * D.n);
+            return sum(c.Selectivity(D.x));
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector x = nograd_assign(D.x);
+            cstar::LogisticCurve<dvar_vector,dvariable> c(p(1), p(2));
+            return sum(c.Selectivity(x));
+        }});
+
+    cases.push_back(BenchCase{"LogisticCurve95",
+        [](const BenchData& D) { return scalars(0.4 * D.n, 0.7 * D.n); },
+        [](const BenchData& D)
+        {
+            cstar::LogisticCurve95<dvector,double> c(0.4 * D.n, 0.7 * D.n);
+            return sum(c.Selectivity(D.x));
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector x = nograd_assign(D.x);
+            cstar::LogisticCurve95<dvar_vector,dvariable> c(p(1), p(2));
+            return sum(c.Selectivity(x));
+        }});
+
+    cases.push_back(BenchCase{"logSelexMeanOne",
+        [](const BenchData& D) { return scalars(0.5 * D.n, 0.1 * D.n); },
+        [](const BenchData& D)
+        {
+            cstar::LogisticCurve<dvector,double> c(0.5 * D.n, 0.1 * D.n);
+            return sum(c.logSelexMeanOne(D.x));
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector x = nograd_assign(D.x);
+            cstar::LogisticCurve<dvar_vector,dvariable> c(p(1), p(2));
+            return sum(c.logSelexMeanOne(x));
+        }});
+
+    cases.push_back(BenchCase{"SelectivityCoefficients",
+        [](const BenchData& D) { return dvector(D.pred); },
+        [](const BenchData& D)
+        {
+            cstar::SelectivityCoefficients<dvector> c(D.pred);
+            return sum(c.Selectivity(D.x));
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector x = nograd_assign(D.x);
+            cstar::SelectivityCoefficients<dvar_vector> c(p);
+            return sum(c.Selectivity(x));
+        }});
+
+    cases.push_back(BenchCase{"ParameterPerClass", curve,
+        [](const BenchData& D)
+        {
+            cstar::ParameterPerClass<dvector> c(-D.y);
+            return sum(c.Selectivity(D.x));
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector x = nograd_assign(D.x);
+            cstar::ParameterPerClass<dvar_vector> c(-p);
+            return sum(c.Selectivity(x));
+        }});
+
+    cases.push_back(BenchCase{"eplogis",
+        [](const BenchData& D) { return scalars(0.3 * D.n, 0.7 * D.n, 0.3); },
+        [](const BenchData& D) { Selex s; return sum(s.eplogis(D.x, 0.3 * D.n, 0.7 * D.n, 0.3)); },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            Selex s;
+            dvar_vector x = nograd_assign(D.x);
+            return sum(s.eplogis(x, p(1), p(2), p(3)));
+        }});
+
+    InitFn means = [](const BenchData& D) { return dvector(D.mu); };
+
+    cases.push_back(BenchCase{"dpois", means,
+        [](const BenchData& D) { return dpois(D.obs, D.mu); },
+        [](const dvar_vector& p, const BenchData& D) { return dpois(D.obs, p); }});
+
+    cases.push_back(BenchCase{"dnbinom",
+        [](const BenchData& D) { dvector v(1,D.n+1); v(1,D.n) = D.mu; v(D.n+1) = 2.; return v; },
+        [](const BenchData& D) { return dnbinom(D.obs, D.mu, 2.); },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvar_vector m = p(1,D.n);
+            return dnbinom(D.obs, m, p(D.n+1));
+        }});
+
+    cases.push_back(BenchCase{"dgamma",
+        [](const BenchData& D) { return scalars(2., 1.5); },
+        [](const BenchData& D) { return sum(dgamma(D.y, 2., 1.5)); },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dvariable a = p(1);
+            dvariable b = p(2);
+            return sum(dgamma(D.y, a, b));
+        }});
+
+    cases.push_back(BenchCase{"dmultifan", means,
+        [](const BenchData& D) { return dmultifan(D.obs, D.mu, 100.); },
+        [](const dvar_vector& p, const BenchData& D) { return dmultifan(D.obs, p, 100.); }});
+
+    // Diagnostics return doubles; in dvariable mode they take dvar_vector predictions
+    InitFn props = [](const BenchData& D) { return dvector(D.pred); };
+
+    cases.push_back(BenchCase{"mn_length", props,
+        [](const BenchData& D) { return mn_length(D.pred, D.x); },
+        [](const dvar_vector& p, const BenchData& D) { return dvariable(mn_length(p, D.x)); }});
+
+    cases.push_back(BenchCase{"sd_length", props,
+        [](const BenchData& D) { return sd_length(D.pred, D.x, D.x); },
+        [](const dvar_vector& p, const BenchData& D) { return dvariable(sd_length(value(p), D.x, D.x)); }});
+
+    cases.push_back(BenchCase{"norm_res", props,
+        [](const BenchData& D) { return sum(norm_res(D.pred, D.prop, 100.)); },
+        [](const dvar_vector& p, const BenchData& D) { return dvariable(sum(norm_res(value(p), D.prop, 100.))); }});
+
+    cases.push_back(BenchCase{"sd_norm_res", props,
+        [](const BenchData& D) { return sd_norm_res(D.pred, D.prop, 100.); },
+        [](const dvar_vector& p, const BenchData& D) { return dvariable(sd_norm_res(p, D.prop, 100.)); }});
+
+    cases.push_back(BenchCase{"eff_N", props,
+        [](const BenchData& D) { return eff_N(D.prop, D.pred); },
+        [](const dvar_vector& p, const BenchData& D) { return dvariable(eff_N(D.prop, p)); }});
+
+    // All five diagnostics above for one composition, from one sweep
+    cases.push_back(BenchCase{"comp_diagnostics", props,
+        [](const BenchData& D)
+        {
+            dmatrix pred(1,1,1,D.n), obs(1,1,1,D.n);
+            dvector m(1,1);
+            pred(1) = D.pred;
+            obs(1)  = D.prop;
+            m       = 100.;
+            CompDiagnostics d = comp_diagnostics(pred, obs, m, D.x);
+            return d.mn_obs(1) + d.sd_obs(1) + sum(d.res(1)) + d.sdnr(1) + d.effN(1);
+        },
+        [](const dvar_vector& p, const BenchData& D)
+        {
+            dmatrix pred(1,1,1,D.n), obs(1,1,1,D.n);
+            dvector m(1,1);
+            pred(1) = value(p);
+            obs(1)  = D.prop;
+            m       = 100.;
+            CompDiagnostics d = comp_diagnostics(pred, obs, m, D.x);
+            return dvariable(d.mn_obs(1) + d.sd_obs(1) + sum(d.res(1)) + d.sdnr(1) + d.effN(1));
+        }});
+
+    // Values straddling eps, so that about half of the elements are clamped and penalised
+    InitFn centred = [](const BenchData& D) { return dvector(D.y - 2.); };
+
+    cases.push_back(BenchCase{"posfun", centred,
+        [](const BenchData& D) { double pen = 0.; return sum(posfun(D.y - 2., 0.1, pen)) + pen; },
+        [](const dvar_vector& p, const BenchData& D) { dvariable pen = 0.; return sum(posfun(p, 0.1, pen)) + pen; }});
+
+    return cases;
+}
+
+// =========================================================================================================
+// Timing
+// =========================================================================================================
+
+typedef std::chrono::steady_clock bench_clock;
+
+static double elapsed_ns(const bench_clock::time_point& t0, const bench_clock::time_point& t1)
+{
+    return std::chrono::duration<double, std::nano>(t1 - t0).count();
+}
+
+// Position in the gradient stack and in the derivative-value buffer (gradfil1/gradfil2)
+struct TapeMark
+{
+    grad_stack_entry* ptr;
+    double offset;
+
+    TapeMark() : ptr(gradient_structure::GRAD_STACK1->ptr),
+                 offset((double)gradient_structure::fp->offset) {}
+};
+
+// Bytes written between two marks
+static double tape_bytes(const TapeMark& m0, const TapeMark& m1)
+{
+    return (double)(m1.ptr - m0.ptr) * sizeof(grad_stack_entry) + (m1.offset - m0.offset);
+}
+
+// About 2*10^6 elements per measurement, and at least 3 repetitions
+static int bench_reps(int n)
+{
+    int reps = 2000000 / n;
+    return reps < 3 ? 3 : reps;
+}
+
+static volatile double bench_sink;
+
+static void run_double(const BenchCase& c, const BenchData& D)
+{
+    int reps = bench_reps(D.n);
+    double s = c.run_double(D);  // warm up
+    bench_clock::time_point t0 = bench_clock::now();
+    for(int r = 0; r < reps; r++)
+    {
+        s += c.run_double(D);
+    }
+    bench_clock::time_point t1 = bench_clock::now();
+    bench_sink = s;
+    printf("%s,double,%d,%d,%.4g,0,0\n", c.name, D.n, reps, elapsed_ns(t0, t1) / (double(reps) * D.n));
+}
+
+static void run_dvar(const BenchCase& c, const BenchData& D)
+{
+    int reps = bench_reps(D.n) / 10;
+    if(reps < 3) reps = 3;
+    dvector p0 = c.init(D);
+    int np = p0.indexmax();
+    dvector g(1,np);
+
+    double fwd = 0., rev = 0., bytes = 0.;
+    for(int r = 0; r <= reps; r++)
+    {
+        independent_variables iv(1,np);
+        iv = p0;
+        dvar_vector p(iv);
+        TapeMark m0;
+
+        bench_clock::time_point t0 = bench_clock::now();
+        dvariable obj = c.run_dvar(p, D);
+        bench_clock::time_point t1 = bench_clock::now();
+        TapeMark m1;
+
+        dvariable f;
+        f = obj;
+        bench_clock::time_point t2 = bench_clock::now();
+        gradcalc(np, g);
+        bench_clock::time_point t3 = bench_clock::now();
+
+        if(r == 0) continue;  // warm up
+        fwd  += elapsed_ns(t0, t1);
+        rev  += elapsed_ns(t2, t3);
+        bytes = tape_bytes(m0, m1);
+    }
+    printf("%s,dvariable,%d,%d,%.4g,%.0f,%.4g\n", c.name, D.n, reps,
+           fwd / (double(reps) * D.n), bytes, rev / (double(reps) * D.n));
+}
+
+// =========================================================================================================
+// Accuracy checks: the fused and vectorized paths against the routines they stand in for
+// =========================================================================================================
+
+static int check_failures = 0;
+
+static void check_error(const char* what, double err, double tol)
+{
+    bool ok = err <= tol;
+    printf("%-48s max error %9.3g  (tolerance %.0e)  %s\n", what, err, tol, ok ? "ok" : "FAILED");
+    if(!ok) check_failures++;
+}
+
+// Relative error, absolute for values near zero
+static double check_rel(double a, double b)
+{
+    return fabs(a - b) / (fabs(b) > 1. ? fabs(b) : 1.);
+}
+
+// comp_diagnostics() against mn_length, sd_length, norm_res, sd_norm_res and eff_N row by row
+static void check_comp_diagnostics()
+{
+    int nr = 6, nb = 40;
+    BenchData D(nb);
+    dmatrix pred(1,nr,1,nb), obs(1,nr,1,nb);
+    dvector m(1,nr);
+    for(int r = 1; r <= nr; r++)
+    {
+        for(int i = 1; i <= nb; i++)
+        {
+            pred(r,i) = 5. + 3. * sin(0.37 * i + r) * sin(0.37 * i + r);
+            obs(r,i)  = floor(pred(r,i) + 2. * cos(0.71 * i * r));
+        }
+        pred(r) /= sum(pred(r));
+        obs(r)  /= sum(obs(r));
+        m(r)     = 20. * r;
+    }
+
+    CompDiagnostics d = comp_diagnostics(pred, obs, m, D.x);
+    double e_mn = 0., e_sd = 0., e_res = 0., e_sdnr = 0., e_effn = 0.;
+    for(int r = 1; r <= nr; r++)
+    {
+        e_mn   = max(e_mn,   check_rel(d.mn_obs(r),  mn_length(obs(r), D.x)));
+        e_mn   = max(e_mn,   check_rel(d.mn_pred(r), mn_length(pred(r), D.x)));
+        e_sd   = max(e_sd,   check_rel(d.sd_obs(r),  sd_length(obs(r), D.x, D.x)));
+        e_sd   = max(e_sd,   check_rel(d.sd_pred(r), sd_length(pred(r), D.x, D.x)));
+        e_sdnr = max(e_sdnr, check_rel(d.sdnr(r),    sd_norm_res(pred(r), obs(r), m(r))));
+        e_effn = max(e_effn, check_rel(d.effN(r),    eff_N(obs(r), pred(r))));
+        dvector res = norm_res(pred(r), obs(r), m(r));
+        for(int i = 1; i <= nb; i++)
+        {
+            e_res = max(e_res, check_rel(d.res(r,i), res(i)));
+        }
+    }
+    check_error("comp_diagnostics mn_length", e_mn, 1e-12);
+    check_error("comp_diagnostics sd_length", e_sd, 1e-10);
+    check_error("comp_diagnostics norm_res", e_res, 1e-12);
+    check_error("comp_diagnostics sd_norm_res", e_sdnr, 1e-10);
+    check_error("comp_diagnostics eff_N", e_effn, 1e-12);
+}
+
+// exp(logSelectivity()) against Selectivity() for LogisticCurve95, including a falling curve
+// (s95 < s50) over an x that is not ascending, where the largest element is not the last
+static void check_logistic95()
+{
+    int n = 30;
+    dvector x(1,n);
+    for(int i = 1; i <= n; i++) x(i) = 2. + 8. * fabs(sin(0.5 * i));
+
+    double err = 0.;
+    double s50[] = {5., 5.}, s95[] = {8., 3.};
+    for(int k = 0; k < 2; k++)
+    {
+        cstar::LogisticCurve95<dvector,double> c(s50[k], s95[k]);
+        dvector sel  = c.Selectivity(x);
+        dvector lsel = c.logSelectivity(x);
+        for(int i = 1; i <= n; i++)
+        {
+            err = max(err, check_rel(exp(lsel(i)), sel(i)));
+        }
+    }
+    check_error("LogisticCurve95 exp(logSelectivity)", err, 1e-12);
+}
+
+// Gradient of f at x, by one reverse sweep
+static dvector check_gradient(const dvector& x, const std::function<dvariable(const dvar_vector&)>& f)
+{
+    int np = x.indexmax();
+    dvector g(1,np);
+    independent_variables iv(1,np);
+    iv = x;
+    dvar_vector p(iv);
+    dvariable obj = f(p);
+    dvariable y;
+    y = obj;
+    gradcalc(np, g);
+    return g;
+}
+
+// lgammafn() and digamma(), double and dvariable, against ADMB's gammln() and its derivative
+// over the integer table, the shifted region below 10 and the Stirling range above it
+static void check_gammafn()
+{
+    std::vector<double> grid;
+    int k;
+    for(k = 1; k <= 300; k++)  grid.push_back(k);                            // table, and past its end
+    for(k = 1; k < 200; k++)   grid.push_back(0.05 * k + 0.0123);            // shifted
+    for(k = 0; k < 100; k++)   grid.push_back(10.5 * pow(1.08, k));          // Stirling
+    int n = (int)grid.size();
+    dvector x(1,n);
+    for(k = 1; k <= n; k++) x(k) = grid[k-1];
+
+    dvector lg   = cstar::lgammafn(x);
+    dvector psi  = cstar::digamma(x);
+    dvector dref = check_gradient(x, [](const dvar_vector& p)
+    {
+        dvariable f = 0.;
+        for(int i = p.indexmin(); i <= p.indexmax(); i++) f += gammln(p(i));
+        return f;
+    });
+    dvector dvec = check_gradient(x, [](const dvar_vector& p) { return sum(cstar::lgammafn(p)); });
+    dvector dsca = check_gradient(x, [](const dvar_vector& p)
+    {
+        dvariable f = 0.;
+        for(int i = p.indexmin(); i <= p.indexmax(); i++) f += cstar::lgammafn(p(i));
+        return f;
+    });
+
+    double e_lg = 0., e_psi = 0., e_dvar = 0.;
+    for(int i = 1; i <= n; i++)
+    {
+        double ref = gammln(x(i));
+        e_lg   = max(e_lg,   check_rel(lg(i), ref));
+        e_lg   = max(e_lg,   check_rel(cstar::lgammafn(x(i)), ref));
+        e_psi  = max(e_psi,  check_rel(psi(i), dref(i)));
+        e_psi  = max(e_psi,  check_rel(cstar::digamma(x(i)), dref(i)));
+        e_dvar = max(e_dvar, check_rel(dvec(i), dref(i)));
+        e_dvar = max(e_dvar, check_rel(dsca(i), dref(i)));
+    }
+    check_error("lgammafn against gammln", e_lg, 1e-10);
+    check_error("digamma against d gammln/dx", e_psi, 1e-9);
+    check_error("lgammafn (dvariable) gradient", e_dvar, 1e-9);
+}
+
+// vexp, vplogis and veplogis at every dispatch level the processor supports, against the
+// scalar loop, and vexp and vplogis against the mfexp() versions they replaced. NaN arguments
+// in a vector lane and in the scalar tail must come out as NaN at every level.
+static void check_simd()
+{
+    int n = 1001;  // odd, so the vector loops leave a scalar tail
+    dvector x(1,n), z(1,n);
+    for(int i = 1; i <= n; i++)
+    {
+        x(i) = -30. + 60. * (i - 1) / (n - 1);
+        z(i) = -750. + 1500. * (i - 1) / (n - 1);
+    }
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    x(6) = z(6) = nan;
+    x(n) = z(n) = nan;
+    double mean = 3., sd = 0.05;  // logistic arguments out to +-660
+
+    int top = cstar::simd_level();
+    dvector e0(1,n), p0(1,n), q0(1,n);
+    for(int level = 0; level <= top; level++)
+    {
+        cstar::simd_set_level(level);
+        dvector e(1,n), p(1,n), q(1,n);
+        cstar::vexp(&z(1), &e(1), n);
+        cstar::vplogis(&x(1), &p(1), n, mean, sd);
+        cstar::veplogis(&x(1), &q(1), n, -5., 10., 0.3);
+        if(level == 0)
+        {
+            e0 = e;
+            p0 = p;
+            q0 = q;
+        }
+
+        double ee = 0., ep = 0., eq = 0., enan = 0.;
+        double e_mf = 0., p_mf = 0.;
+        for(int i = 1; i <= n; i++)
+        {
+            if(std::isnan(x(i)))
+            {
+                enan += !std::isnan(e(i)) + !std::isnan(p(i)) + !std::isnan(q(i));
+                continue;
+            }
+            ee = max(ee, fabs(e(i) - e0(i)) / e0(i));
+            ep = max(ep, fabs(p(i) - p0(i)));
+            eq = max(eq, check_rel(q(i), q0(i)));
+            if(fabs(z(i)) <= 60.) e_mf = max(e_mf, fabs(e(i) - mfexp(z(i))) / mfexp(z(i)));
+            p_mf = max(p_mf, fabs(p(i) - 1. / (1. + mfexp(-(x(i) - mean) / sd))));
+        }
+
+        char what[64];
+        snprintf(what, sizeof(what), "NaN arguments level %d", level);
+        check_error(what, enan, 0.);
+        if(level == 0)
+        {
+            check_error("vexp (scalar) against mfexp on [-60,60]", e_mf, 2e-15);
+            check_error("vplogis (scalar) against mfexp curve", p_mf, 1e-15);
+            continue;
+        }
+        snprintf(what, sizeof(what), "vexp level %d against scalar", level);
+        check_error(what, ee, 2e-15);
+        snprintf(what, sizeof(what), "vplogis level %d against scalar", level);
+        check_error(what, ep, 1e-15);
+        snprintf(what, sizeof(what), "veplogis level %d against scalar", level);
+        check_error(what, eq, 1e-14);
+    }
+    cstar::simd_set_level(top);
+}
+
+static int run_checks()
+{
+    check_comp_diagnostics();
+    check_logistic95();
+    check_gammafn();
+    check_simd();
+    printf("%d check(s) failed\n", check_failures);
+    return check_failures ? 1 : 0;
+}
+
+// =========================================================================================================
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+    int maxn           = argc > 2 ? atoi(argv[2]) : 100000;
+
+    // Room for the largest case without spilling the tape to disk
+    gradient_structure::set_GRADSTACK_BUFFER_SIZE(20000000L);
+    gradient_structure::set_CMPDIF_BUFFER_SIZE(400000000L);
+    gradient_structure::set_ARRAY_MEMBLOCK_SIZE(400000000L);
+    gradient_structure::set_MAX_NVAR_OFFSET(200000);
+    gradient_structure gs(400000000L);
+
+    if(strcmp(filter, "check") == 0) return run_checks();
+
+    std::vector<BenchCase> cases = bench_cases();
+    printf("routine,mode,n,reps,ns_per_element,stack_bytes,reverse_ns_per_element\n");
+    for(int n = 10; n <= maxn; n *= 10)
+    {
+        BenchData D(n);
+        for(size_t k = 0; k < cases.size(); k++)
+        {
+            if(*filter && !strstr(cases[k].name, filter)) continue;
+            run_double(cases[k], D);
+            run_dvar(cases[k], D);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
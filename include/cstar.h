@@ -19,6 +19,8 @@
 
 #include <admodel.h>
 #include "selex.hpp"
+#include "parallel.hpp"
+#include "instrument.hpp"
 
 // #include "generic.cpp"
 // #include "dpois.cpp"
@@ -27,6 +29,131 @@
 // #include "dmultifan.cpp"
 // #include "approx.cpp"
 
+// =========================================================================================================
+// Observation data: in 'obsvector.cpp'
+// =========================================================================================================
+
+// Observed numbers with the data-only terms used by the densities computed once, e.g. in the DATA_SECTION:
+class ObsVector{
+private:
+    dvector m_obs;        // observed numbers (counts)
+    dvector m_prop;       // observed proportions, obs/sum(obs)
+    double  m_sum;        // sum(obs)
+    double  m_lnfact;     // sum(log(obs!))
+    double  m_cap;        // maximum sample size (<= 0 for none)
+    double  m_nsample;    // sample size, min(sum(obs),cap)
+
+public:
+    ~ObsVector() {}  // Destructor
+
+    ObsVector() : m_sum(0.), m_lnfact(0.), m_cap(0.), m_nsample(0.) {}
+    ObsVector(const dvector& obs, const double& cap = 0.);
+
+    void Set_obs(const dvector& obs, const double& cap = 0.);
+
+    const dvector& Obs()  const { return m_obs;     }
+    const dvector& Prop() const { return m_prop;    }
+    double Sum()          const { return m_sum;     }
+    double LnFact()       const { return m_lnfact;  }
+    double Cap()          const { return m_cap;     }
+    double SampleSize()   const { return m_nsample; }
+    int indexmin()        const { return m_obs.indexmin(); }
+    int indexmax()        const { return m_obs.indexmax(); }
+};
+
+
+// =========================================================================================================
+// Composition archives: in 'comparchive.cpp'
+// =========================================================================================================
+
+// One composition (e.g. a haul, year and fleet) read in place from a CompArchive; nothing is copied, so a
+// CompRow is only valid while its archive stays open. Holds the same data-only terms as an ObsVector:
+class CompRow{
+private:
+    const double* m_obs;  // observed numbers, m_obs[0] is bin indexmin()
+    int     m_lb;
+    int     m_ub;
+    double  m_sum;        // sum(obs)
+    double  m_lnfact;     // sum(log(obs!))
+    double  m_nsample;    // sample size, min(sum(obs),cap)
+    int     m_year;
+    int     m_fleet;
+
+public:
+    ~CompRow() {}  // Destructor
+
+    CompRow() : m_obs(0), m_lb(1), m_ub(0), m_sum(0.), m_lnfact(0.), m_nsample(0.), m_year(0), m_fleet(0) {}
+    CompRow(const double* obs, int lb, int ub, double sum, double lnfact, double nsample, int year, int fleet)
+        : m_obs(obs), m_lb(lb), m_ub(ub), m_sum(sum), m_lnfact(lnfact), m_nsample(nsample),
+          m_year(year), m_fleet(fleet) {}
+
+    double operator()(int i) const { return m_obs[i-m_lb]; }
+    double Prop(int i)       const { return (m_sum > 0.) ? m_obs[i-m_lb]/m_sum : 0.; }
+    const double* Data()     const { return m_obs;     }
+    double Sum()             const { return m_sum;     }
+    double LnFact()          const { return m_lnfact;  }
+    double SampleSize()      const { return m_nsample; }
+    int Year()               const { return m_year;    }
+    int Fleet()              const { return m_fleet;   }
+    int indexmin()           const { return m_lb;      }
+    int indexmax()           const { return m_ub;      }
+
+    // Copies, for routines that have no CompRow overload:
+    dvector Obs()  const;
+    dvector Prop() const;
+};
+
+// Read-only, memory-mapped binary archive of compositions, e.g. every haul x year x fleet x size bin.
+// Opening reads only the header; rows are paged in from the file as they are used, so neither the
+// startup time nor the resident memory grows with the size of the archive. Convert() writes an
+// archive from a text file laid out as
+//   nrows nbins
+//   bin midpoints (nbins)
+//   year fleet obs(1) ... obs(nbins)      (nrows lines)
+// with comments starting at '#'.
+class CompArchive{
+private:
+    void*         m_map;       // start of the mapping
+    size_t        m_bytes;     // length of the mapping
+    void*         m_handle;    // file mapping handle (Windows only)
+    int           m_nrows;
+    int           m_nbins;
+    int           m_lb;        // index of the first bin
+    double        m_cap;       // maximum sample size (<= 0 for none)
+    const double* m_bins;
+    const int*    m_year;
+    const int*    m_fleet;
+    const double* m_sum;
+    const double* m_lnfact;
+    const double* m_obs;       // nrows x nbins, row-major
+
+    CompArchive(const CompArchive&);
+    CompArchive& operator=(const CompArchive&);
+
+public:
+    ~CompArchive();
+
+    CompArchive();
+    CompArchive(const char* file, const double& cap = 0.);
+
+    void Open(const char* file, const double& cap = 0.);
+    void Close();
+
+    bool IsOpen()  const { return m_map != 0; }
+    int NumRows()  const { return m_nrows; }
+    int NumBins()  const { return m_nbins; }
+    int indexmin() const { return 1;       }
+    int indexmax() const { return m_nrows; }
+
+    dvector Bins() const;               // bin midpoints, e.g. mlen for mn_length()
+    CompRow Row(int r) const;           // r = 1..NumRows()
+    CompRow operator()(int r) const { return Row(r); }
+
+    // Write a binary archive from the text layout above:
+    static void Convert(const char* text_file, const char* archive_file);
+};
+
+
 // =========================================================================================================
 // Generic functions: in 'generic.cpp'
 // =========================================================================================================
@@ -34,25 +161,92 @@
 // Get mean length for variable objects:
 double mn_length(const dvector& pobs, const dvector& mlen);
 double mn_length(const dvar_vector& pobs, const dvector& mlen);
+double mn_length(const CompRow& obs, const dvector& mlen);
 
 // Get standard deviation of mean length vector:
 double sd_length(const dvector& pobs, const dvector& len, const dvector& mlen);
+double sd_length(const CompRow& obs, const dvector& len, const dvector& mlen);
 
 // Get normalized residulas of composition data given sample size:
 dvector norm_res(const dvector& pred, const dvector& obs, double m);
+dvector norm_res(const dvector& pred, const ObsVector& obs);
+dvector norm_res(const dvector& pred, const CompRow& obs);
 
 // Get standard deviation of normalized residuals given observed and predicted proportions:
+double sd_norm_res(const dvector& pred, const dvector& obs, double m);
 double sd_norm_res(const dvar_vector& pred, const dvector& obs, double m);
+double sd_norm_res(const dvector& pred, const ObsVector& obs);
+double sd_norm_res(const dvar_vector& pred, const ObsVector& obs);
+double sd_norm_res(const dvector& pred, const CompRow& obs);
+double sd_norm_res(const dvar_vector& pred, const CompRow& obs);
 
 // Get effective sample size:
+double eff_N(const dvector& pobs, const dvector& phat);
 double eff_N(const dvector& pobs, const dvar_vector& phat);
+double eff_N(const ObsVector& obs, const dvector& phat);
+double eff_N(const ObsVector& obs, const dvar_vector& phat);
+double eff_N(const CompRow& obs, const dvector& phat);
+double eff_N(const CompRow& obs, const dvar_vector& phat);
 
-// Return penalised positive values for some given vector:
+// Composition diagnostics for every row of a year (or haul) x bin matrix, from one sweep over the data:
+struct CompDiagnostics{
+    dvector mn_obs;       // mn_length() of the observed proportions
+    dvector mn_pred;      // mn_length() of the predicted proportions
+    dvector sd_obs;       // sd_length() of the observed proportions, with len = mlen
+    dvector sd_pred;      // sd_length() of the predicted proportions, with len = mlen
+    dmatrix res;          // norm_res(), one row per composition
+    dvector sdnr;         // sd_norm_res()
+    dvector effN;         // eff_N()
+};
+
+// Rows of obs are observed proportions and m(i) their sample sizes; rows of an archive are matched to
+// rows of pred by position. The versions with an out argument reuse its storage, e.g. once per MCMC draw:
+CompDiagnostics comp_diagnostics(const dmatrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen);
+CompDiagnostics comp_diagnostics(const dvar_matrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen);
+CompDiagnostics comp_diagnostics(const dmatrix& pred, const CompArchive& obs, const dvector& mlen);
+void comp_diagnostics(const dmatrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen, CompDiagnostics& out);
+void comp_diagnostics(const dmatrix& pred, const CompArchive& obs, const dvector& mlen, CompDiagnostics& out);
+
+// Return penalised positive values for some given vector (or each row of a matrix):
 dvar_vector posfun(const dvar_vector& x, const double& eps, dvariable& pen);
+dvar_matrix posfun(const dvar_matrix& x, const double& eps, dvariable& pen);
+dvector posfun(const dvector& x, const double& eps, double& pen);
+dmatrix posfun(const dmatrix& x, const double& eps, double& pen);
 
-// Return a vector of postitions of first matches of a given value x, in a table:
+// Return a vector of postitions of first matches of a given value x, in a table (table.indexmin()-1 for none):
 ivector match(const ivector& x, const ivector& table);
 
+// Lookup index over a fixed table of codes (e.g. years or size codes), built once and queried many times,
+// in 'matchindex.cpp'. Codes spanning a small range get a direct map, others an open-addressing hash:
+class MatchIndex{
+private:
+    int      m_lb;         // table.indexmin(); m_lb-1 means no match
+    int      m_n;          // number of entries in the table
+    bool     m_dense;      // direct map rather than hash
+    int      m_min;        // smallest code (direct map)
+    ivector  m_slot;       // direct map: position of code m_min+k; hash: position in the table
+    ivector  m_key;        // hash: code held in each slot
+    unsigned m_shift;      // hash: 32 - log2(number of slots)
+
+public:
+    ~MatchIndex() {}  // Destructor
+
+    MatchIndex() : m_lb(1), m_n(0), m_dense(true), m_min(0), m_shift(32) {}
+    MatchIndex(const ivector& table);
+
+    void Set_table(const ivector& table);
+
+    int  NoMatch()  const { return m_lb-1; }
+    bool IsDense()  const { return m_dense; }
+
+    // Position of the first entry of the table equal to x, or NoMatch():
+    int Find(int x) const;
+
+    // Find() for every element of x:
+    ivector Match(const ivector& x) const;
+    void    Match(const ivector& x, ivector& pos) const;
+};
+
 
 // =========================================================================================================
 // Density functions: in 'function_name.cpp'
@@ -61,21 +255,69 @@ ivector match(const ivector& x, const ivector& table);
 // Poisson density function:
 dvariable dpois(const dvector& k, const dvar_vector& lambda);
 
+// Poisson density function with the data-only term dpois_lnfact(k) computed once, e.g. in PRELIMINARY_CALCS:
+double    dpois_lnfact(const dvector& k);
+dvariable dpois(const dvector& k, const dvar_vector& lambda, const double& lnfact);
+dvariable dpois(const ObsVector& k, const dvar_vector& lambda);
+dvariable dpois(const CompRow& k, const dvar_vector& lambda);
+
+// Poisson density function for double predictions (simulation and reports), with no derivative information:
+double dpois(const dvector& k, const dvector& lambda);
+double dpois(const dvector& k, const dvector& lambda, const double& lnfact);
+double dpois(const ObsVector& k, const dvector& lambda);
+double dpois(const CompRow& k, const dvector& lambda);
+
 // Gamma density function:
 dvariable dgamma(const prevariable& x, const double& a, const double& b);
 dvar_vector dgamma(const dvector& x, const dvariable& a, const dvariable& b);
+double      dgamma(const double& x, const double& a, const double& b);
+dvector     dgamma(const dvector& x, const double& a, const double& b);
+
+// Log of the gamma density (shape a, scale b), with analytic derivatives for x, a and b:
+dvariable   ldgamma(const double& x, const prevariable& a, const prevariable& b);
+dvariable   ldgamma(const prevariable& x, const prevariable& a, const prevariable& b);
+dvar_vector ldgamma(const dvector& x, const prevariable& a, const prevariable& b);
+dvar_vector ldgamma(const dvar_vector& x, const prevariable& a, const prevariable& b);
+double      ldgamma(const double& x, const double& a, const double& b);
+dvector     ldgamma(const dvector& x, const double& a, const double& b);
 
 // Multifan-style density function:
 dvariable dmultifan(const dvector& o, const dvar_vector& p, const double& s);
+dvariable dmultifan(const ObsVector& o, const dvar_vector& p);
+dvariable dmultifan(const CompRow& o, const dvar_vector& p);
+double    dmultifan(const dvector& o, const dvector& p, const double& s);
+double    dmultifan(const ObsVector& o, const dvector& p);
+double    dmultifan(const CompRow& o, const dvector& p);
 
 // Negative binomial density function:
 dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k);
+dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k, const double& lnfact);
+dvariable dnbinom(const ObsVector& x, const dvar_vector& mu, const prevariable& k);
+dvariable dnbinom(const CompRow& x, const dvar_vector& mu, const prevariable& k);
+double    dnbinom(const dvector& x, const dvector& mu, const double& k);
+double    dnbinom(const dvector& x, const dvector& mu, const double& k, const double& lnfact);
+double    dnbinom(const ObsVector& x, const dvector& mu, const double& k);
+double    dnbinom(const CompRow& x, const dvector& mu, const double& k);
 
 
 // =========================================================================================================
 // Other functions: in 'function_name.cpp'
 // =========================================================================================================
 
+namespace cstar {
+
+// Log gamma function for x > 0, tabulated for small integers and vectorized: in 'gammafn.cpp'
+double      lgammafn(const double& x);
+dvector     lgammafn(const dvector& x);
+dvariable   lgammafn(const prevariable& x);
+dvar_vector lgammafn(const dvar_vector& x);
+
+// Digamma function, the derivative of log gamma, for x > 0: in 'gammafn.cpp'
+double  digamma(const double& x);
+dvector digamma(const dvector& x);
+
+}//cstar
+
 
 
 // Put the entire contents of your header here...
@@ -84,6 +326,72 @@ dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k)
 double approx(const double& v, const dvector& x, const dvector& y);
 dvariable approx(const double& v, const dvector& x, const dvar_vector& y);
 
+// Linearly interpolate at every point in xout (one merge walk when xout is sorted):
+dvector     approx(const dvector& xout, const dvector& x, const dvector& y);
+dvar_vector approx(const dvector& xout, const dvector& x, const dvar_vector& y);
+
+// Interpolation table over a fixed x grid: O(1) lookup for evenly spaced knots, and a cached
+// stencil for a fixed set of output points so that each evaluation is a single weighted gather:
+class ApproxTable{
+private:
+    dvector m_x;          // knots (data only)
+    bool    m_uniform;    // evenly spaced knots
+    double  m_x0;         // first knot
+    double  m_dx;         // knot spacing, if uniform
+
+    dvector m_xout;       // fixed output points
+    ivector m_lo;         // lower knot for each output point
+    dvector m_w;          // weight on the knot above lo
+    ivector m_edge;       // -1/+1 if below/above the knots, else 0
+
+    void Stencil(const dvector& xout, ivector& lo, dvector& w, ivector& edge) const;
+
+public:
+    ~ApproxTable() {}  // Destructor
+
+    ApproxTable() : m_uniform(false), m_x0(0.), m_dx(0.) {}
+    ApproxTable(const dvector& x);
+    ApproxTable(const dvector& x, const dvector& xout);
+
+    void Set_x(const dvector& x);
+    void Set_xout(const dvector& xout);
+
+    bool IsUniform() const { return m_uniform; }
+
+    // Interpolate y at the cached output points:
+    dvector     Interpolate(const dvector& y) const;
+    dvar_vector Interpolate(const dvar_vector& y) const;
+
+    // Interpolate y at new output points, without caching them:
+    dvector     Interpolate(const dvector& xout, const dvector& y) const;
+    dvar_vector Interpolate(const dvector& xout, const dvar_vector& y) const;
+};
+
+// Bilinearly interpolate z(x1,x2) at every point of the grid x1out by x2out (clamped at the edges):
+dmatrix     bilinear(const dvector& x1out, const dvector& x2out, const dvector& x1, const dvector& x2, const dmatrix& z);
+dvar_matrix bilinear(const dvector& x1out, const dvector& x2out, const dvector& x1, const dvector& x2, const dvar_matrix& z);
+
+// Bilinear interpolation table with cached stencils for a fixed output grid, e.g. year by size:
+class BilinearTable{
+private:
+    ivector m_lo1;        // lower x1 knot for each output row
+    dvector m_w1;         // weight on the x1 knot above
+    ivector m_lo2;        // lower x2 knot for each output column
+    dvector m_w2;         // weight on the x2 knot above
+
+public:
+    ~BilinearTable() {}  // Destructor
+
+    BilinearTable() {}
+    BilinearTable(const dvector& x1, const dvector& x2, const dvector& x1out, const dvector& x2out);
+
+    void Set_grid(const dvector& x1, const dvector& x2, const dvector& x1out, const dvector& x2out);
+
+    // Interpolate z (rows on x1, columns on x2) over the whole output grid:
+    dmatrix     Interpolate(const dmatrix& z) const;
+    dvar_matrix Interpolate(const dvar_matrix& z) const;
+};
+
 
 
 // =========================================================================================================
@@ -117,6 +425,8 @@ public:
     // Linear interpolation
     dvector     linapprox(const dvector& x, const dvector& y, const dvector& xout);
     dvar_vector linapprox(const dvector& x, const dvar_vector& y, const dvector& xout);
+    dvector     linapprox(const ApproxTable& table, const dvector& y);
+    dvar_vector linapprox(const ApproxTable& table, const dvar_vector& y);
     
     dvariable GetMu()  { return m_mu; }
     dvariable GetSd()  { return m_sd; }
@@ -0,0 +1,189 @@
+/**
+*
+* \file instrument.hpp
+* \brief Optional instrumentation of the Cstar routines
+* \ingroup CSTAR
+*
+* Each public routine opens with CSTAR_SCOPE("name"), or CSTAR_SCOPE_N("name", x)
+* when it has a vector or matrix argument x whose length is worth recording. The
+* macros expand to nothing unless the library and the model are compiled with
+*
+*   -DCSTAR_TAPE_STATS   gradient-stack bytes and variable slots used per routine
+*   -DCSTAR_PROFILE      call counts, cycles and input lengths per routine, and a trace
+*
+* in which case a summary is written when the program exits. The two can be used
+* together, but the tape counters then add to the times.
+*
+* \date 10/18/2026
+*
+ */
+
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+#ifdef CSTAR_TAPE_STATS
+
+#include <atomic>
+#include <iosfwd>
+
+namespace cstar {
+
+// =========================================================================================================
+// TapeStats: Gradient-stack footprint per routine: in 'tapestats.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Running totals for one instrumented routine (one per call site)
+	 * @details Counters register themselves on first use; the report merges those
+	 * with the same name, e.g. the instantiations of a template.
+	 */
+	struct TapeCounter
+	{
+		const char *name;
+		std::atomic<long>      calls;
+		std::atomic<long long> bytes;    // gradient stack plus derivative buffer
+		std::atomic<long long> slots;    // dvar_vector elements left allocated
+		std::atomic<long long> peak;     // largest byte count of a single call
+		std::atomic<long>      spills;   // calls during which the stack went to disk
+		TapeCounter *next;
+
+		explicit TapeCounter(const char *name);
+	};
+
+	/**
+	 * @brief Measures the tape written between construction and destruction
+	 * @details Only the outermost instrumented call on a thread is counted, so a routine
+	 * that calls another Cstar routine is charged for both and the totals add up to what
+	 * the library wrote. Nothing is counted when no gradient_structure exists.
+	 */
+	class TapeScope
+	{
+	public:
+		explicit TapeScope(TapeCounter &counter);
+		~TapeScope();
+
+	private:
+		TapeScope(const TapeScope&);
+		TapeScope& operator=(const TapeScope&);
+
+		TapeCounter &m_counter;
+		bool      m_outer;
+		long long m_stack;
+		long long m_offset;
+		long long m_slots;
+	};
+
+	// Write the summary table; called automatically at exit
+	void TapeStatsReport(std::ostream &os);
+
+} // namespace cstar
+
+// The counter is never freed, so it is still there when the report runs at exit
+#define CSTAR_TAPE_SCOPE_(name)                                               \
+	static cstar::TapeCounter &cstar_tape_counter_ = *new cstar::TapeCounter(name); \
+	cstar::TapeScope cstar_tape_scope_(cstar_tape_counter_)
+
+#else
+
+#define CSTAR_TAPE_SCOPE_(name)
+
+#endif /* CSTAR_TAPE_STATS */
+
+#ifdef CSTAR_PROFILE
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace cstar {
+
+// =========================================================================================================
+// Profile: Call counts, cycles and input lengths per routine: in 'profile.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Time stamp counter, in cycles on x86 and in nanoseconds elsewhere
+	 */
+	inline unsigned long long profile_ticks()
+	{
+	#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+	#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	#endif
+	}
+
+	// Number of elements (or rows) of any ADMB vector or matrix
+	template<class V>
+	inline long scope_length(const V &x)
+	{
+		return (long)x.indexmax() - x.indexmin() + 1;
+	}
+
+	// Register an instrumented call site and return its id; the first call arranges the report
+	int ProfileRegister(const char *name);
+
+	class ProfileScope;
+	extern thread_local ProfileScope *t_profile_top;
+
+	/**
+	 * @brief Times the enclosing routine
+	 * @details The start and stop ticks are read inline; the bookkeeping happens after the
+	 * stop tick, in thread-local buffers, so threads never share a cache line or a lock.
+	 * Time spent in instrumented routines called from this one is subtracted to give the
+	 * self time.
+	 */
+	class ProfileScope
+	{
+	public:
+		ProfileScope(int id, long n)
+			: m_id(id), m_n(n), m_child(0), m_parent(t_profile_top)
+		{
+			t_profile_top = this;
+			m_start = profile_ticks();
+		}
+
+		~ProfileScope()
+		{
+			unsigned long long stop = profile_ticks();
+			Record(stop);
+		}
+
+	private:
+		ProfileScope(const ProfileScope&);
+		ProfileScope& operator=(const ProfileScope&);
+
+		void Record(unsigned long long stop);
+
+		int  m_id;
+		long m_n;
+		unsigned long long m_start;
+		unsigned long long m_child;
+		ProfileScope *m_parent;
+	};
+
+	/**
+	 * @brief Write the Chrome trace (trace_file, JSON) and the flat summary (summary_file)
+	 * @details Called automatically at exit with cstar_profile.json and cstar_profile.txt,
+	 * or with the prefix given by the environment variable CSTAR_PROFILE_OUT.
+	 */
+	void ProfileReport(const char *trace_file, const char *summary_file);
+
+} // namespace cstar
+
+#define CSTAR_PROFILE_SCOPE_(name, n)                                         \
+	static const int cstar_profile_id_ = cstar::ProfileRegister(name);          \
+	cstar::ProfileScope cstar_profile_scope_(cstar_profile_id_, n)
+
+#else
+
+#define CSTAR_PROFILE_SCOPE_(name, n)
+
+#endif /* CSTAR_PROFILE */
+
+#define CSTAR_SCOPE_N(name, x) CSTAR_TAPE_SCOPE_(name); CSTAR_PROFILE_SCOPE_(name, cstar::scope_length(x))
+#define CSTAR_SCOPE(name)      CSTAR_TAPE_SCOPE_(name); CSTAR_PROFILE_SCOPE_(name, -1L)
+
+#endif /* INSTRUMENT_HPP */
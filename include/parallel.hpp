@@ -0,0 +1,85 @@
+/**
+*
+* \file parallel.hpp
+* \brief Thread pool and deterministic parallel reduction for double computations
+* \ingroup CSTAR
+*
+* \date 10/18/2026
+*
+ */
+
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+
+/**
+ * @defgroup Parallel
+ * @Parallel Value-only likelihood components (e.g. dpois, dnbinom and dmultifan over years and
+ * fleets on double data, during mceval, simulation or reporting) can be evaluated across threads.
+ *
+ * Only pure-double work may run on the pool: the ADMB gradient stack is not thread safe, so no
+ * dvariable or dvar_vector may be created inside a task.
+ *
+ * Example, in a TPL file:
+ * <br> cstar::ThreadPool pool;                         // one per program, e.g. in GLOBALS_SECTION
+ * <br> double nll = cstar::parallel_sum(pool, nyr, [&](int i)
+ * <br>     { return dpois(obs(syr+i), value(pred(syr+i))); });
+ */
+
+namespace cstar {
+
+// =========================================================================================================
+// ThreadPool: Work-stealing pool of worker threads: in 'parallel.cpp'
+// =========================================================================================================
+
+	/**
+	 * @ingroup Parallel
+	 * @brief A fixed set of worker threads that run index ranges of a loop
+	 * @details ParallelFor() cuts [0,n) into chunks and deals them out to one queue per thread,
+	 * the calling thread included. Each thread takes chunks from the front of its own queue and,
+	 * when that is empty, steals from the back of the others, so uneven components balance out.
+	 * ParallelFor() returns when every index has run, and rethrows the first exception thrown
+	 * by f. A ParallelFor() issued from inside a task runs serially on that thread.
+	 */
+	class ThreadPool
+	{
+	public:
+		// nthreads counts the calling thread; 0 means one per hardware thread
+		explicit ThreadPool(int nthreads = 0);
+		~ThreadPool();
+
+		int  Size() const;
+		void ParallelFor(int n, const std::function<void(int)> &f);
+
+	private:
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+		struct Impl;
+		Impl *m_impl;
+	};
+
+// =========================================================================================================
+// Deterministic reductions: in 'parallel.cpp'
+// =========================================================================================================
+
+	/**
+	 * @ingroup Parallel
+	 * @brief Pairwise (cascade) sum of n doubles, in a fixed order
+	 * @details The rounding error grows as O(log n) rather than O(n), and the result depends
+	 * only on the values and their order.
+	 */
+	double pairwise_sum(const double *x, int n);
+
+	/**
+	 * @ingroup Parallel
+	 * @brief Sum of f(i) for i in [0,n), with the components evaluated on the pool
+	 * @details Each component is stored at its own index and the results are combined with
+	 * pairwise_sum(), so the total is bitwise identical for any number of threads.
+	 */
+	double parallel_sum(ThreadPool &pool, int n, const std::function<double(int)> &f);
+
+} // namespace cstar
+
+#endif /* PARALLEL_HPP */
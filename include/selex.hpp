@@ -13,6 +13,7 @@
 #define SELEX_HPP
 
 #include <admodel.h>
+#include "instrument.hpp"
 #include "cstar.h"
 
 /**
@@ -32,6 +33,63 @@
 
 namespace cstar {
 
+// =========================================================================================================
+// SelexCache: Memoized selectivity curves
+// =========================================================================================================
+
+	/**
+	 * @brief Parameter values used as cache keys
+	 * @details Overloads that strip the derivative information from double, dvariable,
+	 * dvector and dvar_vector parameters.
+	 */
+	inline double  CacheValue(const double &x)      { return x;        }
+	inline double  CacheValue(const prevariable &x) { return value(x); }
+	inline dvector CacheValue(const dvector &x)     { return x;        }
+	inline dvector CacheValue(const dvar_vector &x) { return value(x); }
+
+	/**
+	 * @brief Element and matrix types of each vector type, and how a cached curve is returned
+	 * @details Double curves can always be cached and are returned as a deep copy. A dvar_vector
+	 * curve is only cached when nothing it depends on is active (see Selex::Caching()), and is
+	 * then returned as a constant with no derivative information.
+	 */
+	template<class T> struct SelexTraits;
+
+	template<> struct SelexTraits<dvector>
+	{
+		typedef double value_type;
+		typedef dmatrix matrix_type;
+		static bool Cacheable(bool fixed) { return true; }
+		static const dvector Copy(const dvector &c)
+		{
+			dvector y(c.indexmin(),c.indexmax());
+			y = c;
+			return y;
+		}
+	};
+
+	template<> struct SelexTraits<dvar_vector>
+	{
+		typedef dvariable value_type;
+		typedef dvar_matrix matrix_type;
+		static bool Cacheable(bool fixed) { return fixed; }
+		static const dvar_vector Copy(const dvector &c) { return nograd_assign(c); }
+	};
+
+	/**
+	 * @brief One cached curve: the parameter values, the x vector it was computed for, and the result
+	 */
+	struct SelexCacheEntry
+	{
+		bool        valid;
+		const void* xaddr;
+		dvector     x;
+		dvector     par;
+		dvector     curve;
+
+		SelexCacheEntry() : valid(false), xaddr(0) {}
+	};
+
 // =========================================================================================================
 // Selex: Defined Base Class for Selectivity Functions
 // =========================================================================================================
@@ -42,6 +100,16 @@ namespace cstar {
 	 * @details Classes that derive from this class overload the pure virtual functions:<br><br>
 	 * const T Selectivity(const T &x) const <br>
 	 * 
+	 * Curves are memoized on the parameter values and the identity (and values) of x, with one
+	 * slot each for Selectivity, logSelectivity and logSelexMeanOne. Double curves are always
+	 * cached. A cached dvar_vector curve is a constant, so it is only cached when it can carry
+	 * no derivatives at all:
+	 * - SetDataX(true) declares that x is data (not computed from estimated parameters, such as
+	 *   growth or length-at-age), since the cache recognises x by its values only;
+	 * - SetFixed(true), or SetFixed(par...) from the parameters themselves, declares that the
+	 *   selectivity parameters are not active. It holds for the phase it was called in only; in
+	 *   a later phase the curves are recomputed until SetFixed() is called again.
+	 * 
 	 * @tparam x Independent variable (ie. age or size) for calculating selectivity.
 	 */
 
@@ -51,7 +119,78 @@ namespace cstar {
 	private:
 		T m_x;
 
+		bool m_fixed;
+		bool m_data_x;
+		int  m_fixed_phase;
+		mutable long m_hits;
+		mutable long m_misses;
+		mutable SelexCacheEntry m_cache[3];
+
+	protected:
+		enum { kSelectivity = 0, kLogSelectivity = 1, kLogSelexMeanOne = 2 };
+
+		// True if curves may be cached; callers skip the cache otherwise. For dvar_vector curves
+		// x must be data and the parameters fixed in the current phase.
+		bool Caching() const
+		{
+			return SelexTraits<T>::Cacheable(m_fixed && m_data_x
+			                                 && m_fixed_phase == initial_params::current_phase);
+		}
+
+		// True, and counts a hit, if the curve in slot was computed for these parameters and x
+		bool CacheFind(int slot, const dvector &par, const T &x) const
+		{
+			const SelexCacheEntry &c = m_cache[slot];
+			if( !Caching() || !c.valid || c.xaddr != &x
+			    || x.indexmin() != c.x.indexmin() || x.indexmax() != c.x.indexmax()
+			    || par.indexmin() != c.par.indexmin() || par.indexmax() != c.par.indexmax() )
+			{
+				return false;
+			}
+			int i;
+			for(i = par.indexmin(); i <= par.indexmax(); i++)
+			{
+				if( par(i) != c.par(i) ) return false;
+			}
+			dvector xv = CacheValue(x);
+			for(i = xv.indexmin(); i <= xv.indexmax(); i++)
+			{
+				if( xv(i) != c.x(i) ) return false;
+			}
+			m_hits++;
+			return true;
+		}
+
+		const T CacheGet(int slot) const
+		{
+			return SelexTraits<T>::Copy(m_cache[slot].curve);
+		}
+
+		// Counts a miss, stores y in slot if it can be cached, and returns y
+		const T CacheKeep(int slot, const dvector &par, const T &x, const T &y) const
+		{
+			m_misses++;
+			if( Caching() )
+			{
+				SelexCacheEntry &c = m_cache[slot];
+				c.xaddr = &x;
+				c.x.deallocate();
+				c.x.allocate(x.indexmin(),x.indexmax());
+				c.x = CacheValue(x);
+				c.par.deallocate();
+				c.par.allocate(par.indexmin(),par.indexmax());
+				c.par = par;
+				c.curve.deallocate();
+				c.curve.allocate(y.indexmin(),y.indexmax());
+				c.curve = CacheValue(y);
+				c.valid = true;
+			}
+			return y;
+		}
+
 	public:
+		Selex() : m_fixed(false), m_data_x(false), m_fixed_phase(0), m_hits(0), m_misses(0) {}
+
 		virtual  const T Selectivity(const T &x) const = 0;
 
 		virtual  const T logSelectivity(const T &x) const = 0;
@@ -62,8 +201,199 @@ namespace cstar {
 
 		void Set_x(T & x) { this-> m_x = x; }
 		T    Get_x() const{ return m_x;     }
+
+		// x is data, with no derivatives of its own, so dvar_vector curves on it may be cached
+		void SetDataX(bool data) { m_data_x = data; if( !data ) ClearCache(); }
+		bool GetDataX() const    { return m_data_x; }
+
+		// Parameters are fixed (not active) in the current phase, so dvar_vector curves may be cached
+		void SetFixed(bool fixed)
+		{
+			m_fixed       = fixed;
+			m_fixed_phase = initial_params::current_phase;
+			if( !fixed ) ClearCache();
+		}
+
+		// Fixed exactly when none of the given model parameters is active in the current phase
+		void SetFixed(const initial_params &p1)
+		{
+			SetFixed(!active(p1));
+		}
+
+		void SetFixed(const initial_params &p1, const initial_params &p2)
+		{
+			SetFixed(!active(p1) && !active(p2));
+		}
+
+		void SetFixed(const initial_params &p1, const initial_params &p2, const initial_params &p3)
+		{
+			SetFixed(!active(p1) && !active(p2) && !active(p3));
+		}
+		bool GetFixed() const     { return m_fixed; }
+
+		long GetCacheHits()   const { return m_hits;   }
+		long GetCacheMisses() const { return m_misses; }
+
+		void ClearCache()
+		{
+			for(int i = 0; i < 3; i++) m_cache[i].valid = false;
+		}
 	};
 
+// =========================================================================================================
+// lognormalize: Normalization of log selectivity curves: in 'lognormalize.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Normalizations for log selectivity
+	 * @details kMeanOne rescales the selectivity to a mean of one, kMaxOne to a maximum of one,
+	 * and kLastOne to one at the last element, as plogis95() does.
+	 */
+	enum SelexNormType { kMeanOne, kMaxOne, kLastOne };
+
+	/**
+	 * @brief Shift a log selectivity curve so that the selectivity has a mean, maximum or last element of one
+	 * @details The mean is taken as a log-sum-exp about the largest element, so steep curves
+	 * neither overflow nor underflow. out may be the same vector as y. The dvar_vector
+	 * versions push a single derivative record.
+	 */
+	dvector     lognormalize(const dvector &y, int type = kMeanOne);
+	dvar_vector lognormalize(const dvar_vector &y, int type = kMeanOne);
+	void        lognormalize(const dvector &y, dvector &out, int type);
+	void        lognormalize(const dvar_vector &y, dvar_vector &out, int type);
+
+// =========================================================================================================
+// SelexStatic: Statically dispatched selectivity interface
+// =========================================================================================================
+
+	/**
+	 * @ingroup Selectivities
+	 * @brief Statically dispatched (CRTP) selectivity interface with caller-owned output
+	 * @details Derived classes implement the public kernel<br><br>
+	 * void EvalSelectivity(const T &x, T &out) const <br>
+	 * dvector CacheKey() const <br><br>
+	 * and may hide EvalLogSelectivity() to compute the curve in log space, or
+	 * EvalLogSelexMeanOne() to change the normalization. The output-parameter
+	 * methods Selectivity(x, out), logSelectivity(x, out) and logSelexMeanOne(x, out) call the
+	 * kernel directly: no virtual call, no returned temporaries, and no allocation for double
+	 * data. out must already span the bounds of x; these methods bypass the curve cache.
+	 * The virtual by-value methods of Selex<T> are thin adapters over them for existing TPL code.
+	 * 
+	 * @tparam Derived the selectivity class deriving from SelexStatic
+	 * @tparam T data vector or dvar vector
+	 */
+
+	template<class Derived, class T>
+	class SelexStatic: public Selex<T>
+	{
+	private:
+		const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+	public:
+		typedef typename SelexTraits<T>::value_type value_type;
+
+		void Selectivity(const T &x, T &out) const
+		{
+			CSTAR_SCOPE_N("Selectivity", x);
+			derived().EvalSelectivity(x, out);
+		}
+
+		void logSelectivity(const T &x, T &out) const
+		{
+			CSTAR_SCOPE_N("logSelectivity", x);
+			derived().EvalLogSelectivity(x, out);
+		}
+
+		void logSelexMeanOne(const T &x, T &out) const
+		{
+			CSTAR_SCOPE_N("logSelexMeanOne", x);
+			derived().EvalLogSelexMeanOne(x, out);
+		}
+
+		// Log of the selectivity curve
+		void EvalLogSelectivity(const T &x, T &out) const
+		{
+			derived().EvalSelectivity(x, out);
+			for(int i = out.indexmin(); i <= out.indexmax(); i++)
+			{
+				out(i) = log(out(i));
+			}
+		}
+
+		// Log selectivity rescaled so that the selectivity has a mean of one
+		void EvalLogSelexMeanOne(const T &x, T &out) const
+		{
+			derived().EvalLogSelectivity(x, out);
+			lognormalize(out, out, kMeanOne);
+		}
+
+		const T Selectivity(const T &x) const
+		{
+			CSTAR_SCOPE_N("Selectivity", x);
+			if( !this->Caching() )
+			{
+				T y(x.indexmin(),x.indexmax());
+				Selectivity(x, y);
+				return y;
+			}
+			dvector key = derived().CacheKey();
+			if( this->CacheFind(this->kSelectivity, key, x) ) return this->CacheGet(this->kSelectivity);
+			T y(x.indexmin(),x.indexmax());
+			Selectivity(x, y);
+			return this->CacheKeep(this->kSelectivity, key, x, y);
+		}
+
+		const T logSelectivity(const T &x) const
+		{
+			CSTAR_SCOPE_N("logSelectivity", x);
+			if( !this->Caching() )
+			{
+				T y(x.indexmin(),x.indexmax());
+				logSelectivity(x, y);
+				return y;
+			}
+			dvector key = derived().CacheKey();
+			if( this->CacheFind(this->kLogSelectivity, key, x) ) return this->CacheGet(this->kLogSelectivity);
+			T y(x.indexmin(),x.indexmax());
+			logSelectivity(x, y);
+			return this->CacheKeep(this->kLogSelectivity, key, x, y);
+		}
+
+		const T logSelexMeanOne(const T &x) const
+		{
+			CSTAR_SCOPE_N("logSelexMeanOne", x);
+			if( !this->Caching() )
+			{
+				T y(x.indexmin(),x.indexmax());
+				logSelexMeanOne(x, y);
+				return y;
+			}
+			dvector key = derived().CacheKey();
+			if( this->CacheFind(this->kLogSelexMeanOne, key, x) ) return this->CacheGet(this->kLogSelexMeanOne);
+			T y(x.indexmin(),x.indexmax());
+			logSelexMeanOne(x, y);
+			return this->CacheKeep(this->kLogSelexMeanOne, key, x, y);
+		}
+	};
+
+// =========================================================================================================
+// Vectorized kernels for double data: in 'simd.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Fused curve kernels over raw arrays of n doubles
+	 * @details Each kernel computes the whole curve in one pass, with no temporaries, using
+	 * AVX2/FMA or SSE2 when the processor supports it (chosen at run time).
+	 * simd_level() returns 2 for AVX2, 1 for SSE2 and 0 for the scalar loop. simd_set_level()
+	 * lowers the level in use (for testing each path; it is capped at what the processor
+	 * supports) and returns the previous one.
+	 */
+	int  simd_level();
+	int  simd_set_level(int level);
+	void vexp(const double* x, double* y, int n);
+	void vplogis(const double* x, double* y, int n, const double& mean, const double& sd);
+	void veplogis(const double* x, double* y, int n, const double& x1, const double& x2, const double& gamma);
+
 // =========================================================================================================
 // plogis: Base functions for logistic-based selectivity functions
 // =========================================================================================================
@@ -80,18 +410,270 @@ namespace cstar {
 	template<class T,class T2>
 	const T plogis(const T &x, const T2 &mean, const T2 &sd)
 	{
+		CSTAR_SCOPE_N("plogis", x);
 		return T2(1.0)/(T2(1.0)+mfexp(-(x-mean)/sd));
 	}
 
 	
+	/**
+	 * @brief Logistic function for double data, evaluated by the vectorized kernel
+	 */
+	template<>
+	inline const dvector plogis<dvector,double>(const dvector &x, const double &mean, const double &sd)
+	{
+		CSTAR_SCOPE_N("plogis", x);
+		dvector y(x.indexmin(),x.indexmax());
+		if(y.indexmax() >= y.indexmin())
+			vplogis(&x.elem(x.indexmin()), &y.elem(y.indexmin()), size_count(x), mean, sd);
+		return y;
+	}
+
+	/**
+	 * @brief Logistic function written into caller-owned storage
+	 * @param out Selectivity, allocated with the bounds of x
+	 */
+	template<class T,class T2,class T3>
+	void plogis(const T &x, const T2 &mean, const T2 &sd, T3 &out)
+	{
+		for(int i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			out(i) = 1.0/(1.0+mfexp(-(x(i)-mean)/sd));
+		}
+	}
+
+	template<>
+	inline void plogis<dvector,double,dvector>(const dvector &x, const double &mean, const double &sd, dvector &out)
+	{
+		if(x.indexmax() >= x.indexmin())
+			vplogis(&x.elem(x.indexmin()), &out.elem(x.indexmin()), size_count(x), mean, sd);
+	}
+
+	/**
+	 * @brief Log of the logistic function, written into caller-owned storage
+	 * @details Evaluated as -log(1+exp(-z)) or z-log(1+exp(z)), whichever exponent is not
+	 * positive, so the log selectivity stays finite far into the tails.
+	 * @param out Log selectivity, allocated with the bounds of x
+	 */
+	template<class T,class T2,class T3>
+	void lplogis(const T &x, const T2 &mean, const T2 &sd, T3 &out)
+	{
+		typedef typename SelexTraits<T3>::value_type value_type;
+		for(int i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			value_type z = (x(i)-mean)/sd;
+			if( CacheValue(z) >= 0 ) out(i) = -log(1.0+exp(-z));
+			else                     out(i) = z - log(1.0+exp(z));
+		}
+	}
+
 	template<class T, class T2>
 	const T plogis95(const T &x, const T2 &s50, const T2 &s95)
 	{
-		dvar_vector selex	= T2(1.0)/(T2(1.0)+(exp(-log(19)*((x-s50)/(s95-s50)))));
-    selex /= selex(selex.indexmax());	
+		CSTAR_SCOPE_N("plogis95", x);
+		T selex(x.indexmin(),x.indexmax());
+		plogis95(x, s50, s95, selex);
 		return selex;
 	}
 
+	/**
+	 * @brief Logistic function parameterised with 50% and 95% selectivity, written into
+	 * caller-owned storage and scaled so the last element is one
+	 * @param out Selectivity, allocated with the bounds of x
+	 */
+	template<class T, class T2, class T3>
+	void plogis95(const T &x, const T2 &s50, const T2 &s95, T3 &out)
+	{
+		int i;
+		for(i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			out(i) = 1.0/(1.0+exp(-log(19.)*((x(i)-s50)/(s95-s50))));
+		}
+		typename SelexTraits<T3>::value_type smax = out(out.indexmax());
+		for(i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			out(i) /= smax;
+		}
+	}
+
+// =========================================================================================================
+// Analytic-gradient logistic curves: in 'selex.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Logistic, logistic95, log logistic and exponential logistic curves for dvariable parameters
+	 * @details Each curve is computed in one loop and pushes one record to the gradient stack,
+	 * whose adjoint applies the closed-form partial derivatives with respect to the 2-3
+	 * parameters (and to x when x is a dvar_vector). These overloads are chosen ahead of the
+	 * generic templates whenever the parameters are dvariables.
+	 */
+	dvar_vector plogis(const dvector &x, const dvariable &mean, const dvariable &sd);
+	dvar_vector plogis(const dvar_vector &x, const dvariable &mean, const dvariable &sd);
+	void        plogis(const dvector &x, const dvariable &mean, const dvariable &sd, dvar_vector &out);
+	void        plogis(const dvar_vector &x, const dvariable &mean, const dvariable &sd, dvar_vector &out);
+	dvar_vector plogis95(const dvector &x, const dvariable &s50, const dvariable &s95);
+	dvar_vector plogis95(const dvar_vector &x, const dvariable &s50, const dvariable &s95);
+	void        plogis95(const dvector &x, const dvariable &s50, const dvariable &s95, dvar_vector &out);
+	void        plogis95(const dvar_vector &x, const dvariable &s50, const dvariable &s95, dvar_vector &out);
+	void        lplogis(const dvector &x, const dvariable &mean, const dvariable &sd, dvar_vector &out);
+	void        lplogis(const dvar_vector &x, const dvariable &mean, const dvariable &sd, dvar_vector &out);
+	dvar_vector eplogis(const dvector &x, const dvariable &x1, const dvariable &x2, const dvariable &gamma);
+	dvar_vector eplogis(const dvar_vector &x, const dvariable &x1, const dvariable &x2, const dvariable &gamma);
+
+// =========================================================================================================
+// Batched logistic curves: in 'selex.cpp'
+// =========================================================================================================
+
+	/**
+	 * @brief Many logistic curves over one shared x, one row per curve
+	 * @details Parameters are passed as struct-of-arrays: element i of mean and sd (or s50
+	 * and s95) defines row i of the returned matrix, whose columns span the bounds of x.
+	 * Each row is one sweep of the vectorized kernel, and the dvar_vector versions push a
+	 * single derivative record for the whole matrix.
+	 */
+	dmatrix     plogis(const dvector &x, const dvector &mean, const dvector &sd);
+	dvar_matrix plogis(const dvector &x, const dvar_vector &mean, const dvar_vector &sd);
+	dmatrix     plogis95(const dvector &x, const dvector &s50, const dvector &s95);
+	dvar_matrix plogis95(const dvector &x, const dvar_vector &s50, const dvar_vector &s95);
+
+// =========================================================================================================
+// Time-varying logistic curves: year by size matrices from base parameters plus deviations
+// =========================================================================================================
+
+	/**
+	 * @brief How deviations enter time-varying selectivity
+	 * @details kBlockDev: in year t the parameter is base + dev(iyr(t)), so iyr maps each year to
+	 * its time block. kRandomWalkDev: the parameter is carried forward from the previous year and
+	 * dev(iyr(t)) is added to it. Either way a year whose iyr(t) lies outside the bounds of dev
+	 * has no deviation.
+	 */
+	enum SelexDevType { kBlockDev, kRandomWalkDev };
+
+	/**
+	 * @brief Vector type of a time-varying curve: dvar_vector if x, the base parameters or the
+	 * deviations carry derivatives, dvector otherwise
+	 */
+	template<class X> struct SelexIsVar           { static const bool value = false; };
+	template<> struct SelexIsVar<prevariable>     { static const bool value = true;  };
+	template<> struct SelexIsVar<dvariable>       { static const bool value = true;  };
+	template<> struct SelexIsVar<dvar_vector>     { static const bool value = true;  };
+
+	template<bool V> struct SelexVectorOf         { typedef dvector type;     };
+	template<> struct SelexVectorOf<true>         { typedef dvar_vector type; };
+
+	template<class T, class T2, class D> struct SelexDevTraits
+	{
+		typedef typename SelexVectorOf<SelexIsVar<T>::value || SelexIsVar<T2>::value
+		                               || SelexIsVar<D>::value>::type vector_type;
+		typedef typename SelexTraits<vector_type>::value_type value_type;
+		typedef typename SelexTraits<vector_type>::matrix_type matrix_type;
+	};
+
+	/**
+	 * @brief The effective parameter for each year, and whether it repeats the previous year
+	 * @details A year repeats when it falls in the same block as the year before, or, for a
+	 * random walk, when it adds no deviation. Repeats are decided by index, not by value, so
+	 * that each estimated deviation keeps its derivative.
+	 */
+	template<class T2, class D, class P>
+	void selex_dev_path(const T2 &base, const D &dev, const ivector &iyr, int type, P &p, ivector &same)
+	{
+		int i1 = iyr.indexmin();
+		for(int t = i1; t <= iyr.indexmax(); t++)
+		{
+			int k    = iyr(t);
+			bool has = k >= dev.indexmin() && k <= dev.indexmax();
+			if( type == kBlockDev )
+			{
+				same(t) = t > i1 && k == iyr(t-1);
+				if( same(t) )   p(t) = p(t-1);
+				else if( has )  p(t) = base + dev(k);
+				else            p(t) = base;
+			}
+			else
+			{
+				same(t) = t > i1 && !has;
+				if( t == i1 )   p(t) = base;
+				else            p(t) = p(t-1);
+				if( has )       p(t) += dev(k);
+			}
+		}
+	}
+
+	/**
+	 * @brief Time-varying logistic selectivity with deviations to the mean
+	 * @details Returns one row per year (the bounds of iyr) and one column per element of x.
+	 * Rows that repeat the previous year are copied rather than recomputed, so a blocked
+	 * curve costs one curve evaluation per block. A dvar_matrix still records each copied
+	 * row on the gradient stack, one element per column.
+	 * 
+	 * @param  x Independent variable (e.g. age or size)
+	 * @param  mean, sd Base parameters of the logistic curve
+	 * @param  dev Deviations to the mean, indexed by iyr
+	 * @param  iyr Index into dev for each year
+	 * @param  type kBlockDev or kRandomWalkDev
+	 * @tparam D dvector or dvar_vector of deviations. The result is a dvar_matrix if any of x,
+	 * the base parameters or the deviations is a dvar type, and a dmatrix otherwise.
+	 */
+	template<class T, class T2, class D>
+	const typename SelexDevTraits<T,T2,D>::matrix_type
+	plogis_dev(const T &x, const T2 &mean, const T2 &sd, const D &dev, const ivector &iyr, int type)
+	{
+		CSTAR_SCOPE_N("plogis_dev", x);
+		typedef SelexDevTraits<T,T2,D> traits;
+		typedef typename traits::value_type value_type;
+		int t1 = iyr.indexmin();
+		int t2 = iyr.indexmax();
+		typename traits::vector_type p(t1,t2);
+		ivector same(t1,t2);
+		selex_dev_path(mean, dev, iyr, type, p, same);
+
+		typename traits::matrix_type y(t1,t2,x.indexmin(),x.indexmax());
+		value_type s = sd;
+		for(int t = t1; t <= t2; t++)
+		{
+			if( same(t) )
+			{
+				y(t) = y(t-1);
+				continue;
+			}
+			value_type m = p(t);
+			plogis(x, m, s, y(t));
+		}
+		return y;
+	}
+
+	/**
+	 * @brief Time-varying logistic95 selectivity with deviations to s50
+	 * @details As for plogis_dev(), with each row scaled to one at the last element.
+	 */
+	template<class T, class T2, class D>
+	const typename SelexDevTraits<T,T2,D>::matrix_type
+	plogis95_dev(const T &x, const T2 &s50, const T2 &s95, const D &dev, const ivector &iyr, int type)
+	{
+		CSTAR_SCOPE_N("plogis95_dev", x);
+		typedef SelexDevTraits<T,T2,D> traits;
+		typedef typename traits::value_type value_type;
+		int t1 = iyr.indexmin();
+		int t2 = iyr.indexmax();
+		typename traits::vector_type p(t1,t2);
+		ivector same(t1,t2);
+		selex_dev_path(s50, dev, iyr, type, p, same);
+
+		typename traits::matrix_type y(t1,t2,x.indexmin(),x.indexmax());
+		value_type s = s95;
+		for(int t = t1; t <= t2; t++)
+		{
+			if( same(t) )
+			{
+				y(t) = y(t-1);
+				continue;
+			}
+			value_type m = p(t);
+			plogis95(x, m, s, y(t));
+		}
+		return y;
+	}
+
 // =========================================================================================================
 // LogisticCurve: Logistic-based selectivity function with options
 // =========================================================================================================
@@ -105,7 +687,7 @@ namespace cstar {
 	 */
 
 	template<class T,class T2>
-	class LogisticCurve: public Selex<T>
+	class LogisticCurve: public SelexStatic<LogisticCurve<T,T2>,T>
 	{
 	private:
 		T2 m_mean;
@@ -121,21 +703,22 @@ namespace cstar {
 		void SetMean(T2 mean) { this->m_mean = mean;}
 		void SetStd(T2 std)   { this->m_std  = std; }
 
-		const T Selectivity(const T &x) const
+		dvector CacheKey() const
 		{
-			return cstar::plogis<T>(x, this->GetMean(), this->GetStd());
+			dvector key(1,2);
+			key(1) = CacheValue(m_mean);
+			key(2) = CacheValue(m_std);
+			return key;
 		}
 
-		const T logSelectivity(const T &x) const
+		void EvalSelectivity(const T &x, T &out) const
 		{
-			return log(cstar::plogis<T>(x, this->GetMean(), this->GetStd()));
+			cstar::plogis(x, m_mean, m_std, out);
 		}
 
-		const T logSelexMeanOne(const T &x) const
+		void EvalLogSelectivity(const T &x, T &out) const
 		{
-			T y = log(cstar::plogis<T>(x, this->GetMean(), this->GetStd()));
-			y  -= log(mean(mfexp(y)));
-			return y;
+			cstar::lplogis(x, m_mean, m_std, out);
 		}
 
 	};
@@ -153,7 +736,7 @@ namespace cstar {
    */
 
   template<class T,class T2>
-  class LogisticCurve95: public Selex<T>
+  class LogisticCurve95: public SelexStatic<LogisticCurve95<T,T2>,T>
   {
   private:
     T2 m_s50;
@@ -169,21 +752,26 @@ namespace cstar {
     void SetS50(T2 s50) { this->m_s50 = s50; }
     void SetS95(T2 s95) { this->m_s95 = s95; }
 
-    const T Selectivity(const T &x) const
+    dvector CacheKey() const
     {
-      return cstar::plogis95<T>(x, this->GetS50(), this->GetS95());
+      dvector key(1,2);
+      key(1) = CacheValue(m_s50);
+      key(2) = CacheValue(m_s95);
+      return key;
     }
 
-    const T logSelectivity(const T &x) const
+    void EvalSelectivity(const T &x, T &out) const
     {
-      return log(cstar::plogis95<T>(x, this->GetS50(), this->GetS95()));
+      cstar::plogis95(x, m_s50, m_s95, out);
     }
 
-    const T logSelexMeanOne(const T &x) const
+    // In log space: the logistic with sd = (s95-s50)/log(19), shifted to zero at the last
+    // element so that exp(logSelectivity()) is Selectivity()
+    void EvalLogSelectivity(const T &x, T &out) const
     {
-      T y = log(cstar::plogis95<T>(x, this->GetS50(), this->GetS95()));
-      y  -= log(mean(mfexp(y)));
-      return y;
+      T2 sd = (m_s95 - m_s50)/log(19.);
+      cstar::lplogis(x, m_s50, sd, out);
+      cstar::lognormalize(out, out, kLastOne);
     }
 
   };
@@ -204,6 +792,7 @@ namespace cstar {
 	template<class T>
 	const T coefficients(const T &x, const T &sel_coeffs)
 	{
+		CSTAR_SCOPE_N("coefficients", x);
 		int x1 = x.indexmin();
 		int x2 = x.indexmax();
 		int y2 = sel_coeffs.indexmax();
@@ -216,6 +805,21 @@ namespace cstar {
 		return y;
 	}
 
+	/**
+	 * @brief Nonparametric selectivity coefficients written into caller-owned storage
+	 * @param out Selectivity, allocated with the bounds of x
+	 */
+	template<class T>
+	void coefficients(const T &x, const T &sel_coeffs, T &out)
+	{
+		int y2 = sel_coeffs.indexmax();
+		for(int i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			if( i < y2 ) out(i) = sel_coeffs(i);
+			else         out(i) = sel_coeffs(y2);
+		}
+	}
+
 // =========================================================================================================
 // SelectivityCoefficients: Age/size-specific selectivity coefficients for n-1 age/size classes
 // =========================================================================================================	
@@ -227,7 +831,7 @@ namespace cstar {
 	 * @tparam T vector of coefficients
 	 */
 	template<class T>
-	class SelectivityCoefficients: public Selex<T>
+	class SelectivityCoefficients: public SelexStatic<SelectivityCoefficients<T>,T>
 	{
 	private:
 		T m_sel_coeffs;
@@ -239,23 +843,12 @@ namespace cstar {
 		T GetSelCoeffs() const { return m_sel_coeffs;    }
 		void SetSelCoeffs(T x) { this->m_sel_coeffs = x; }
 
-		const T Selectivity(const T &x) const
-		{
-			// Call the age/size specific function
-			return cstar::coefficients(x, this->GetSelCoeffs());
-		}
+		dvector CacheKey() const { return CacheValue(m_sel_coeffs); }
 
-		const T logSelectivity(const T &x) const
+		void EvalSelectivity(const T &x, T &out) const
 		{
 			// Call the age/size specific function
-			return log(cstar::coefficients(x, this->GetSelCoeffs()));
-		}
-
-		const T logSelexMeanOne(const T &x) const
-		{
-			T y = log(cstar::coefficients(x, this->GetSelCoeffs()));
-			y  -= log(mean(mfexp(y)));
-			return y;
+			cstar::coefficients(x, m_sel_coeffs, out);
 		}
 	};
 
@@ -274,15 +867,35 @@ namespace cstar {
 	template<class T>
 	const T nonparametric(const T &x, const T &selparms)
 	{
+		CSTAR_SCOPE_N("nonparametric", x);
 	  int x2 = x.indexmax();
-	  dvar_vector selex(1,x2);
+	  T selex(1,x2);
 		for (int i=1; i<=x2; i++)
     	selex(i) = (1.0)/(1.0+mfexp(selparms(i)));
-	  dvariable temp = selex(x2);
+	  typename SelexTraits<T>::value_type temp = selex(x2);
     selex /= temp;
     return selex;
 	}
 
+	/**
+	 * @brief Nonparametric selectivity function written into caller-owned storage
+	 * @param out Selectivity, allocated with the bounds of x
+	 */
+	template<class T>
+	void nonparametric(const T &x, const T &selparms, T &out)
+	{
+		int i;
+		for(i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			out(i) = 1.0/(1.0+mfexp(selparms(i)));
+		}
+		typename SelexTraits<T>::value_type temp = out(out.indexmax());
+		for(i = x.indexmin(); i <= x.indexmax(); i++)
+		{
+			out(i) /= temp;
+		}
+	}
+
 // =========================================================================================================
 // ParameterPerClass: One age/size-specific selectivity parameter for each age/size class
 // =========================================================================================================	
@@ -294,7 +907,7 @@ namespace cstar {
 	 * @tparam T vector of parameters (initial values)
 	 */
 	template<class T>
-	class ParameterPerClass: public Selex<T>
+	class ParameterPerClass: public SelexStatic<ParameterPerClass<T>,T>
 	{
 	private:
 		T m_selparms;
@@ -306,23 +919,18 @@ namespace cstar {
 		T GetSelparms() const { return m_selparms; }
 		void SetSelparms(T selparms) { this->m_selparms = selparms; }
 
-		const T Selectivity(const T &x) const
-		{
-			// Call the age/size specific function
-			return cstar::nonparametric(x, this->GetSelparms());
-		}
+		dvector CacheKey() const { return CacheValue(m_selparms); }
 
-		const T logSelectivity(const T &x) const
+		void EvalSelectivity(const T &x, T &out) const
 		{
 			// Call the age/size specific function
-			return log(cstar::nonparametric(x, this->GetSelparms()));
+			cstar::nonparametric(x, m_selparms, out);
 		}
 
-		const T logSelexMeanOne(const T &x) const
+		// Already scaled to a maximum of one, so the log selectivity is not rescaled to mean one
+		void EvalLogSelexMeanOne(const T &x, T &out) const
 		{
-			T y = log(cstar::nonparametric(x, this->GetSelparms()));
-			//y  -= log(mean(mfexp(y)));
-			return y;
+			this->logSelectivity(x, out);
 		}
 	};
 
@@ -20,6 +20,7 @@
   
 double approx(const double& v, const dvector& x, const dvector& y)
 {
+    CSTAR_SCOPE("approx");
     /* Approximate  y(v),  given (x,y)[i], i = 0,..,n-1 */
     int i, j, ij;
 
@@ -52,6 +53,7 @@ double approx(const double& v, const dvector& x, const dvector& y)
 
 dvariable approx(const double& v, const dvector& x, const dvar_vector& y)
 {
+    CSTAR_SCOPE("approx");
     /* Approximate  y(v),  given (x,y)[i], i = 0,..,n-1 */
     int i, j, ij;
 
@@ -80,6 +82,323 @@ dvariable approx(const double& v, const dvector& x, const dvar_vector& y)
     /* linear */
     return y[i] + (y[j] - y[i]) * ((v - x[i])/(x[j] - x[i]));
 }/* approx() */
+
+
+// =========================================================================================================
+// Batched interpolation: approximate y at every point in xout with a single walk over x.
+// =========================================================================================================
+
+/*
+ * Given the interval x[i] <= v found by a search, set the lower knot and the
+ * weight on the knot above it. Exact hits on a knot carry zero weight, so the
+ * results agree exactly with the scalar approx() above.
+ */
+static inline void approx_knot(const double& v, const dvector& x, int i, int& lo, double& w)
+{
+    int j = (i < x.indexmax() - 1) ? i + 1 : i;
+    w = 0.;
+    if(v == x[j])      lo = j;
+    else if(v == x[i]) lo = i;
+    else
+    {
+        lo = i;
+        w  = (v - x[i])/(x[j] - x[i]);
+    }
+}
+
+/*
+ * Build the interpolation stencil for xout: for each point the lower knot lo[k],
+ * the weight w[k] given to the knot above it, and an edge flag (-1 below the
+ * domain, +1 above it, 0 inside). The domain (x[indexmin()] to x[indexmax()-1])
+ * matches the scalar approx().
+ */
+static void approx_stencil(const dvector& xout, const dvector& x,
+                           ivector& lo, dvector& w, ivector& edge)
+{
+    int i, j, ij, k;
+    int i1 = x.indexmin();
+    int i2 = x.indexmax() - 1;
+    double v;
+
+    i = i1;
+    for(k = xout.indexmin(); k <= xout.indexmax(); k++)
+    {
+        v       = xout[k];
+        lo[k]   = i1;
+        w[k]    = 0.;
+        edge[k] = 0;
+
+        /* handle out-of-domain points */
+        if(v < x[i1]) { edge[k] = -1; continue; }
+        if(v > x[i2]) { edge[k] =  1; continue; }
+
+        if(v >= x[i])
+        { /* sorted queries: resume the merge walk from the last interval */
+            while(i < i2 - 1 && x[i + 1] <= v) i++;
+        }
+        else
+        { /* unsorted query: fall back to bisection */
+            i = i1;
+            j = i2;
+            while(i < j - 1)
+            {
+                ij = (i + j)/2;
+                if(v < x[ij]) j = ij;
+                else i = ij;
+            }
+        }
+        approx_knot(v, x, i, lo[k], w[k]);
+    }
+}/* approx_stencil() */
+
+
+/*
+ * Same stencil on an evenly spaced grid: the interval is first guessed by
+ * index arithmetic, then walked down or up until x[i] <= v < x[i+1]. The
+ * guess is normally exact or off by one knot (rounding in (v-x0)/dx), but
+ * the walk goes as far as needed if x is not exactly uniform.
+ */
+static void approx_stencil_uniform(const dvector& xout, const dvector& x,
+                                   const double& x0, const double& dx,
+                                   ivector& lo, dvector& w, ivector& edge)
+{
+    int i, k;
+    int i1 = x.indexmin();
+    int i2 = x.indexmax() - 1;
+    double v;
+
+    for(k = xout.indexmin(); k <= xout.indexmax(); k++)
+    {
+        v       = xout[k];
+        lo[k]   = i1;
+        w[k]    = 0.;
+        edge[k] = 0;
+
+        if(v < x[i1]) { edge[k] = -1; continue; }
+        if(v > x[i2]) { edge[k] =  1; continue; }
+
+        i = i1 + int(floor((v - x0)/dx));
+        if(i > i2 - 1) i = i2 - 1;
+        if(i < i1)     i = i1;
+        while(i > i1 && x[i] > v) i--;
+        while(i < i2 - 1 && x[i + 1] <= v) i++;
+        approx_knot(v, x, i, lo[k], w[k]);
+    }
+}/* approx_stencil_uniform() */
+
+
+/*
+ * Evaluate a stencil against y. Out-of-domain points take min(y) or max(y).
+ */
+static dvector approx_gather(const ivector& lo, const dvector& w, const ivector& edge,
+                             const dvector& y)
+{
+    int k1 = lo.indexmin();
+    int k2 = lo.indexmax();
+    dvector yout(k1,k2);
+
+    double ymin = min(y);
+    double ymax = max(y);
+    for(int k = k1; k <= k2; k++)
+    {
+        if(edge[k] < 0)      yout[k] = ymin;
+        else if(edge[k] > 0) yout[k] = ymax;
+        else if(w[k] == 0.)  yout[k] = y[lo[k]];
+        else yout[k] = y[lo[k]] + (y[lo[k] + 1] - y[lo[k]]) * w[k];
+    }
+    return yout;
+}/* approx_gather() */
+
+
+/*
+ * Adjoint of approx_gather(): each output point depends on at most two
+ * elements of y, so the reverse sweep scatters dfyout through the saved stencil.
+ */
+static void df_approx_gather(void)
+{
+    verify_identifier_string("CSap2");
+    dvector_position wpos  = restore_dvector_position();
+    dvector w              = restore_dvector_value(wpos);
+    ivector_position lopos = restore_ivector_position();
+    ivector lo             = restore_ivector_value(lopos);
+    dvar_vector_position youtpos = restore_dvar_vector_position();
+    dvector dfyout         = restore_dvar_vector_derivatives(youtpos);
+    dvar_vector_position ypos    = restore_dvar_vector_position();
+    verify_identifier_string("CSap1");
+
+    dvector dfy(ypos.indexmin(),ypos.indexmax());
+    dfy.initialize();
+    for(int k = lo.indexmin(); k <= lo.indexmax(); k++)
+    {
+        dfy[lo[k]] += (1. - w[k]) * dfyout[k];
+        if(w[k] != 0.) dfy[lo[k] + 1] += w[k] * dfyout[k];
+    }
+    dfy.save_dvector_derivatives(ypos);
+}/* df_approx_gather() */
+
+
+static dvar_vector approx_gather(const ivector& lo, const dvector& w, const ivector& edge,
+                                 const dvar_vector& y)
+{
+    int k1 = lo.indexmin();
+    int k2 = lo.indexmax();
+    ivector idx(k1,k2);
+    dvector yout(k1,k2);
+
+    /* out-of-domain points take min(y) or max(y): resolve them to knot indices in idx */
+    dvector yv = value(y);
+    int imin = yv.indexmin();
+    int imax = yv.indexmin();
+    for(int i = yv.indexmin(); i <= yv.indexmax(); i++)
+    {
+        if(yv[i] < yv[imin]) imin = i;
+        if(yv[i] > yv[imax]) imax = i;
+    }
+    for(int k = k1; k <= k2; k++)
+    {
+        if(edge[k] < 0)      idx[k] = imin;
+        else if(edge[k] > 0) idx[k] = imax;
+        else                 idx[k] = lo[k];
+        if(w[k] == 0.) yout[k] = yv[idx[k]];
+        else yout[k] = yv[idx[k]] + (yv[idx[k] + 1] - yv[idx[k]]) * w[k];
+    }
+
+    dvar_vector vyout = nograd_assign(yout);
+    save_identifier_string("CSap1");
+    y.save_dvar_vector_position();
+    vyout.save_dvar_vector_position();
+    idx.save_ivector_value();
+    idx.save_ivector_position();
+    w.save_dvector_value();
+    w.save_dvector_position();
+    save_identifier_string("CSap2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_approx_gather);
+    return vyout;
+}/* approx_gather() */
+
+
+dvector approx(const dvector& xout, const dvector& x, const dvector& y)
+{
+    CSTAR_SCOPE_N("approx", xout);
+    /* Approximate  y(xout[k]) for all k, given (x,y)[i] */
+    int k1 = xout.indexmin();
+    int k2 = xout.indexmax();
+    ivector lo(k1,k2);
+    ivector edge(k1,k2);
+    dvector w(k1,k2);
+    approx_stencil(xout, x, lo, w, edge);
+    return approx_gather(lo, w, edge, y);
+}/* approx() */
+
+
+dvar_vector approx(const dvector& xout, const dvector& x, const dvar_vector& y)
+{
+    CSTAR_SCOPE_N("approx", xout);
+    /* Approximate  y(xout[k]) for all k, given (x,y)[i], with one derivative record */
+    int k1 = xout.indexmin();
+    int k2 = xout.indexmax();
+    ivector lo(k1,k2);
+    ivector edge(k1,k2);
+    dvector w(k1,k2);
+    approx_stencil(xout, x, lo, w, edge);
+    return approx_gather(lo, w, edge, y);
+}/* approx() */
+
+
+// =========================================================================================================
+// ApproxTable: interpolation table over a fixed, data-only x grid
+// =========================================================================================================
+
+ApproxTable::ApproxTable(const dvector& x)
+{
+    Set_x(x);
+}
+
+ApproxTable::ApproxTable(const dvector& x, const dvector& xout)
+{
+    Set_x(x);
+    Set_xout(xout);
+}
+
+void ApproxTable::Set_x(const dvector& x)
+{
+    int i1 = x.indexmin();
+    int i2 = x.indexmax();
+    m_x.deallocate();
+    m_x.allocate(i1,i2);
+    m_x = x;
+
+    /* detect an evenly spaced grid (e.g. size-bin midpoints) */
+    m_x0      = x[i1];
+    m_dx      = (i2 > i1) ? (x[i2] - x[i1])/(i2 - i1) : 0.;
+    m_uniform = m_dx > 0.;
+    double tol = 1.e-10 * fabs(x[i2] - x[i1]);
+    for(int i = i1; m_uniform && i <= i2; i++)
+    {
+        if(fabs(x[i] - (m_x0 + (i - i1) * m_dx)) > tol) m_uniform = false;
+    }
+
+    /* a cached stencil refers to the old grid */
+    if(!(!m_lo)) Set_xout(m_xout);
+}
+
+void ApproxTable::Set_xout(const dvector& xout)
+{
+    int k1 = xout.indexmin();
+    int k2 = xout.indexmax();
+    if(&xout != &m_xout)
+    {
+        m_xout.deallocate();
+        m_xout.allocate(k1,k2);
+        m_xout = xout;
+    }
+    m_lo.deallocate();
+    m_lo.allocate(k1,k2);
+    m_w.deallocate();
+    m_w.allocate(k1,k2);
+    m_edge.deallocate();
+    m_edge.allocate(k1,k2);
+    Stencil(m_xout, m_lo, m_w, m_edge);
+}
+
+void ApproxTable::Stencil(const dvector& xout, ivector& lo, dvector& w, ivector& edge) const
+{
+    if(m_uniform) approx_stencil_uniform(xout, m_x, m_x0, m_dx, lo, w, edge);
+    else          approx_stencil(xout, m_x, lo, w, edge);
+}
+
+dvector ApproxTable::Interpolate(const dvector& y) const
+{
+    CSTAR_SCOPE_N("ApproxTable::Interpolate", y);
+    return approx_gather(m_lo, m_w, m_edge, y);
+}
+
+dvar_vector ApproxTable::Interpolate(const dvar_vector& y) const
+{
+    CSTAR_SCOPE_N("ApproxTable::Interpolate", y);
+    return approx_gather(m_lo, m_w, m_edge, y);
+}
+
+dvector ApproxTable::Interpolate(const dvector& xout, const dvector& y) const
+{
+    CSTAR_SCOPE_N("ApproxTable::Interpolate", xout);
+    ivector lo(xout.indexmin(),xout.indexmax());
+    ivector edge(xout.indexmin(),xout.indexmax());
+    dvector w(xout.indexmin(),xout.indexmax());
+    Stencil(xout, lo, w, edge);
+    return approx_gather(lo, w, edge, y);
+}
+
+dvar_vector ApproxTable::Interpolate(const dvector& xout, const dvar_vector& y) const
+{
+    CSTAR_SCOPE_N("ApproxTable::Interpolate", xout);
+    ivector lo(xout.indexmin(),xout.indexmax());
+    ivector edge(xout.indexmin(),xout.indexmax());
+    dvector w(xout.indexmin(),xout.indexmax());
+    Stencil(xout, lo, w, edge);
+    return approx_gather(lo, w, edge, y);
+}
+
 #endif
 // =========================================================================================================
   
\ No newline at end of file
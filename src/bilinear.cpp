@@ -0,0 +1,219 @@
+/**
+*
+* \file bilinear.cpp
+* \brief Bilinear interpolation of gridded data
+* \ingroup CSTAR
+*
+*  Interpolate a matrix of values given on a (x1,x2) grid, e.g. year by
+*  size, at every point of an output grid. The interpolation is separable,
+*  so each axis is reduced to a 1-d stencil that can be cached for fixed
+*  output grids and reused for every new matrix of data.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+// =========================================================================================================
+
+/*
+ * Build the stencil for one axis: the lower knot lo[k] and the weight w[k] on
+ * the knot above it. Output points outside the knots are clamped to the first
+ * or last knot (constant extrapolation), and exact hits carry zero weight.
+ */
+static void bilinear_axis(const dvector& xout, const dvector& x, ivector& lo, dvector& w)
+{
+    int i, j, ij, k;
+    int i1 = x.indexmin();
+    int i2 = x.indexmax();
+    double v;
+
+    for(k = xout.indexmin(); k <= xout.indexmax(); k++)
+    {
+        v     = xout[k];
+        w[k]  = 0.;
+        if(v <= x[i1]) { lo[k] = i1; continue; }
+        if(v >= x[i2]) { lo[k] = i2; continue; }
+
+        /* find the correct interval by bisection */
+        i = i1;
+        j = i2;
+        while(i < j - 1)
+        {
+            ij = (i + j)/2;
+            if(v < x[ij]) j = ij;
+            else i = ij;
+        }
+        lo[k] = i;
+        if(v != x[i]) w[k] = (v - x[i])/(x[j] - x[i]);
+    }
+}/* bilinear_axis() */
+
+
+/*
+ * Evaluate the separable stencil: interpolate along x1 for each output row,
+ * then along x2 for each output column.
+ */
+static dmatrix bilinear_gather(const ivector& lo1, const dvector& w1,
+                               const ivector& lo2, const dvector& w2, const dmatrix& z)
+{
+    int r, c, j;
+    int r1 = lo1.indexmin();
+    int r2 = lo1.indexmax();
+    int c1 = lo2.indexmin();
+    int c2 = lo2.indexmax();
+    int j1 = z.colmin();
+    int j2 = z.colmax();
+    dvector t(j1,j2);
+    dmatrix zout(r1,r2,c1,c2);
+
+    for(r = r1; r <= r2; r++)
+    {
+        const dvector& za = z(lo1[r]);
+        if(w1[r] == 0.)
+        {
+            for(j = j1; j <= j2; j++) t[j] = za[j];
+        }
+        else
+        {
+            const dvector& zb = z(lo1[r] + 1);
+            for(j = j1; j <= j2; j++) t[j] = za[j] + (zb[j] - za[j]) * w1[r];
+        }
+
+        dvector& zr = zout(r);
+        for(c = c1; c <= c2; c++)
+        {
+            if(w2[c] == 0.) zr[c] = t[lo2[c]];
+            else zr[c] = t[lo2[c]] + (t[lo2[c] + 1] - t[lo2[c]]) * w2[c];
+        }
+    }
+    return zout;
+}/* bilinear_gather() */
+
+
+/*
+ * Adjoint of the bilinear gather: scatter dfzout back along x2 into a row
+ * buffer, then along x1 into the rows of z.
+ */
+static void df_bilinear_gather(void)
+{
+    verify_identifier_string("CSbl2");
+    dvector_position w2pos  = restore_dvector_position();
+    dvector w2              = restore_dvector_value(w2pos);
+    ivector_position lo2pos = restore_ivector_position();
+    ivector lo2             = restore_ivector_value(lo2pos);
+    dvector_position w1pos  = restore_dvector_position();
+    dvector w1              = restore_dvector_value(w1pos);
+    ivector_position lo1pos = restore_ivector_position();
+    ivector lo1             = restore_ivector_value(lo1pos);
+    dvar_matrix_position zoutpos = restore_dvar_matrix_position();
+    dmatrix dfzout          = restore_dvar_matrix_derivatives(zoutpos);
+    dvar_matrix_position zpos    = restore_dvar_matrix_position();
+    verify_identifier_string("CSbl1");
+
+    int r, c, j;
+    dmatrix dfz(zpos);
+    dfz.initialize();
+    int j1 = dfz.colmin();
+    int j2 = dfz.colmax();
+    dvector dft(j1,j2);
+
+    for(r = lo1.indexmin(); r <= lo1.indexmax(); r++)
+    {
+        dft.initialize();
+        for(c = lo2.indexmin(); c <= lo2.indexmax(); c++)
+        {
+            dft[lo2[c]] += (1. - w2[c]) * dfzout(r,c);
+            if(w2[c] != 0.) dft[lo2[c] + 1] += w2[c] * dfzout(r,c);
+        }
+        for(j = j1; j <= j2; j++)
+        {
+            dfz(lo1[r],j) += (1. - w1[r]) * dft[j];
+            if(w1[r] != 0.) dfz(lo1[r] + 1,j) += w1[r] * dft[j];
+        }
+    }
+    dfz.save_dmatrix_derivatives(zpos);
+}/* df_bilinear_gather() */
+
+
+static dvar_matrix bilinear_gather(const ivector& lo1, const dvector& w1,
+                                   const ivector& lo2, const dvector& w2, const dvar_matrix& z)
+{
+    dvar_matrix zout = nograd_assign(bilinear_gather(lo1, w1, lo2, w2, value(z)));
+    save_identifier_string("CSbl1");
+    z.save_dvar_matrix_position();
+    zout.save_dvar_matrix_position();
+    lo1.save_ivector_value();
+    lo1.save_ivector_position();
+    w1.save_dvector_value();
+    w1.save_dvector_position();
+    lo2.save_ivector_value();
+    lo2.save_ivector_position();
+    w2.save_dvector_value();
+    w2.save_dvector_position();
+    save_identifier_string("CSbl2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_bilinear_gather);
+    return zout;
+}/* bilinear_gather() */
+
+
+// =========================================================================================================
+// bilinear(): interpolate z(x1,x2) at every point of the grid x1out by x2out
+// =========================================================================================================
+
+dmatrix bilinear(const dvector& x1out, const dvector& x2out,
+                 const dvector& x1, const dvector& x2, const dmatrix& z)
+{
+    CSTAR_SCOPE_N("bilinear", x1out);
+    BilinearTable table(x1, x2, x1out, x2out);
+    return table.Interpolate(z);
+}
+
+dvar_matrix bilinear(const dvector& x1out, const dvector& x2out,
+                     const dvector& x1, const dvector& x2, const dvar_matrix& z)
+{
+    CSTAR_SCOPE_N("bilinear", x1out);
+    BilinearTable table(x1, x2, x1out, x2out);
+    return table.Interpolate(z);
+}
+
+
+// =========================================================================================================
+// BilinearTable: cached stencils for a fixed output grid
+// =========================================================================================================
+
+BilinearTable::BilinearTable(const dvector& x1, const dvector& x2,
+                             const dvector& x1out, const dvector& x2out)
+{
+    Set_grid(x1, x2, x1out, x2out);
+}
+
+void BilinearTable::Set_grid(const dvector& x1, const dvector& x2,
+                             const dvector& x1out, const dvector& x2out)
+{
+    m_lo1.deallocate();
+    m_lo1.allocate(x1out.indexmin(),x1out.indexmax());
+    m_w1.deallocate();
+    m_w1.allocate(x1out.indexmin(),x1out.indexmax());
+    m_lo2.deallocate();
+    m_lo2.allocate(x2out.indexmin(),x2out.indexmax());
+    m_w2.deallocate();
+    m_w2.allocate(x2out.indexmin(),x2out.indexmax());
+    bilinear_axis(x1out, x1, m_lo1, m_w1);
+    bilinear_axis(x2out, x2, m_lo2, m_w2);
+}
+
+dmatrix BilinearTable::Interpolate(const dmatrix& z) const
+{
+    CSTAR_SCOPE_N("BilinearTable::Interpolate", z);
+    return bilinear_gather(m_lo1, m_w1, m_lo2, m_w2, z);
+}
+
+dvar_matrix BilinearTable::Interpolate(const dvar_matrix& z) const
+{
+    CSTAR_SCOPE_N("BilinearTable::Interpolate", z);
+    return bilinear_gather(m_lo1, m_w1, m_lo2, m_w2, z);
+}
+
+// =========================================================================================================
@@ -0,0 +1,361 @@
+/**
+*
+* \file comparchive.cpp
+* \brief Memory-mapped binary archives of composition data
+* \ingroup CSTAR
+*
+*  The archive is columnar: a header, the bin midpoints, then one column
+*  each for year, fleet, sum(obs) and sum(log(obs!)), and last the observed
+*  numbers as an nrows x nbins row-major block, so that every composition
+*  is a contiguous run of doubles that can be used where it lies. Sections
+*  start on 64-byte boundaries. Numbers are stored in the byte order of the
+*  machine that wrote the file; the reader refuses a file of the other order.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// =========================================================================================================
+
+namespace {
+
+const char     kCompMagic[8]  = {'C','S','T','A','R','C','M','P'};
+const uint32_t kCompByteOrder = 0x01020304;
+const uint32_t kCompVersion   = 1;
+
+struct CompFileHeader
+{
+    char     magic[8];
+    uint32_t byteorder;
+    uint32_t version;
+    int64_t  nrows;
+    int32_t  nbins;
+    int32_t  lb;            // index of the first bin
+    int64_t  off_bins;      // byte offsets of the sections
+    int64_t  off_year;
+    int64_t  off_fleet;
+    int64_t  off_sum;
+    int64_t  off_lnfact;
+    int64_t  off_obs;
+    int64_t  bytes;         // size of the whole file
+};
+
+int64_t align64(int64_t n)
+{
+    return (n + 63) & ~(int64_t)63;
+}
+
+void comp_layout(CompFileHeader& h, int64_t nrows, int nbins)
+{
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, kCompMagic, sizeof(h.magic));
+    h.byteorder  = kCompByteOrder;
+    h.version    = kCompVersion;
+    h.nrows      = nrows;
+    h.nbins      = nbins;
+    h.lb         = 1;
+    h.off_bins   = align64(sizeof(CompFileHeader));
+    h.off_year   = align64(h.off_bins   + nbins * (int64_t)sizeof(double));
+    h.off_fleet  = align64(h.off_year   + nrows * (int64_t)sizeof(int32_t));
+    h.off_sum    = align64(h.off_fleet  + nrows * (int64_t)sizeof(int32_t));
+    h.off_lnfact = align64(h.off_sum    + nrows * (int64_t)sizeof(double));
+    h.off_obs    = align64(h.off_lnfact + nrows * (int64_t)sizeof(double));
+    h.bytes      = h.off_obs + nrows * nbins * (int64_t)sizeof(double);
+}
+
+void comp_fail(const char* what, const char* file)
+{
+    cerr << "CompArchive: " << what << " '" << file << "'" << endl;
+    ad_exit(1);
+}
+
+/*
+ * Next number in the text layout, skipping white space and comments that
+ * run from '#' to the end of the line.
+ */
+bool comp_next(std::istream& in, double& x)
+{
+    for(;;)
+    {
+        int c = in.peek();
+        if(c == EOF) return false;
+        if(c == '#')
+        {
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        else if(std::isspace(c))
+        {
+            in.get();
+        }
+        else
+        {
+            return static_cast<bool>(in >> x);
+        }
+    }
+}
+
+bool comp_seek(std::FILE* f, int64_t offset)
+{
+#ifdef _WIN32
+    return _fseeki64(f, offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+} // namespace
+
+
+// =========================================================================================================
+// CompRow
+// =========================================================================================================
+
+dvector CompRow::Obs() const
+{
+    dvector y(m_lb,m_ub);
+    for(int i = m_lb; i <= m_ub; i++) y(i) = m_obs[i-m_lb];
+    return y;
+}
+
+dvector CompRow::Prop() const
+{
+    dvector y(m_lb,m_ub);
+    for(int i = m_lb; i <= m_ub; i++) y(i) = Prop(i);
+    return y;
+}
+
+
+// =========================================================================================================
+// CompArchive
+// =========================================================================================================
+
+CompArchive::CompArchive()
+    : m_map(0), m_bytes(0), m_handle(0), m_nrows(0), m_nbins(0), m_lb(1), m_cap(0.),
+      m_bins(0), m_year(0), m_fleet(0), m_sum(0), m_lnfact(0), m_obs(0)
+{
+}
+
+CompArchive::CompArchive(const char* file, const double& cap)
+    : m_map(0), m_bytes(0), m_handle(0), m_nrows(0), m_nbins(0), m_lb(1), m_cap(0.),
+      m_bins(0), m_year(0), m_fleet(0), m_sum(0), m_lnfact(0), m_obs(0)
+{
+    Open(file, cap);
+}
+
+CompArchive::~CompArchive()
+{
+    Close();
+}
+
+void CompArchive::Open(const char* file, const double& cap)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, 0);
+    if(fh == INVALID_HANDLE_VALUE) comp_fail("cannot open", file);
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(fh, &size) || size.QuadPart < (LONGLONG)sizeof(CompFileHeader))
+    {
+        CloseHandle(fh);
+        comp_fail("not an archive", file);
+    }
+    HANDLE mh = CreateFileMappingA(fh, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(fh);
+    if(!mh) comp_fail("cannot map", file);
+    void* map = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if(!map)
+    {
+        CloseHandle(mh);
+        comp_fail("cannot map", file);
+    }
+    m_handle = mh;
+    m_bytes  = (size_t)size.QuadPart;
+#else
+    int fd = open(file, O_RDONLY);
+    if(fd < 0) comp_fail("cannot open", file);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CompFileHeader))
+    {
+        close(fd);
+        comp_fail("not an archive", file);
+    }
+    void* map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) comp_fail("cannot map", file);
+    m_bytes = (size_t)st.st_size;
+#endif
+    m_map = map;
+
+    const CompFileHeader& h = *static_cast<const CompFileHeader*>(m_map);
+    if(std::memcmp(h.magic, kCompMagic, sizeof(h.magic)) != 0)
+    {
+        Close();
+        comp_fail("not an archive", file);
+    }
+    if(h.byteorder != kCompByteOrder || h.version != kCompVersion)
+    {
+        Close();
+        comp_fail("written with another byte order or version", file);
+    }
+    CompFileHeader expect;
+    comp_layout(expect, h.nrows, h.nbins);
+    if(h.nrows < 0 || h.nrows > INT_MAX || h.nbins < 1
+       || std::memcmp(&h, &expect, sizeof(h)) != 0 || (int64_t)m_bytes < h.bytes)
+    {
+        Close();
+        comp_fail("truncated or damaged archive", file);
+    }
+
+    const char* base = static_cast<const char*>(m_map);
+    m_nrows  = (int)h.nrows;
+    m_nbins  = h.nbins;
+    m_lb     = h.lb;
+    m_cap    = cap;
+    m_bins   = reinterpret_cast<const double*>(base + h.off_bins);
+    m_year   = reinterpret_cast<const int*>(base + h.off_year);
+    m_fleet  = reinterpret_cast<const int*>(base + h.off_fleet);
+    m_sum    = reinterpret_cast<const double*>(base + h.off_sum);
+    m_lnfact = reinterpret_cast<const double*>(base + h.off_lnfact);
+    m_obs    = reinterpret_cast<const double*>(base + h.off_obs);
+}
+
+void CompArchive::Close()
+{
+    if(!m_map) return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_map);
+    CloseHandle(static_cast<HANDLE>(m_handle));
+#else
+    munmap(m_map, m_bytes);
+#endif
+    m_map    = 0;
+    m_handle = 0;
+    m_bytes  = 0;
+    m_nrows  = 0;
+    m_nbins  = 0;
+    m_bins   = 0;
+    m_year   = 0;
+    m_fleet  = 0;
+    m_sum    = 0;
+    m_lnfact = 0;
+    m_obs    = 0;
+}
+
+dvector CompArchive::Bins() const
+{
+    dvector y(m_lb,m_lb+m_nbins-1);
+    for(int i = 0; i < m_nbins; i++) y(m_lb+i) = m_bins[i];
+    return y;
+}
+
+CompRow CompArchive::Row(int r) const
+{
+    if(r < 1 || r > m_nrows)
+    {
+        cerr << "CompArchive::Row: row " << r << " is outside 1.." << m_nrows << endl;
+        ad_exit(1);
+    }
+    int k = r - 1;
+    double n = m_sum[k];
+    return CompRow(m_obs + (size_t)k * m_nbins, m_lb, m_lb+m_nbins-1, n, m_lnfact[k],
+                   (m_cap > 0.) ? min(n,m_cap) : n, m_year[k], m_fleet[k]);
+}
+
+// ------------------------------------------------------------------------------------ //
+
+/*
+ * Stream the text file into the archive one row at a time: the observations
+ * go straight to their place at the end of the file, while the small
+ * per-row columns are collected and written once all the rows are in.
+ */
+void CompArchive::Convert(const char* text_file, const char* archive_file)
+{
+    std::ifstream in(text_file);
+    if(!in) comp_fail("cannot open", text_file);
+
+    double x, y;
+    if(!comp_next(in, x) || !comp_next(in, y) || x < 0 || y < 1)
+        comp_fail("expected the number of rows and bins in", text_file);
+    int64_t nrows = (int64_t)x;
+    int     nbins = (int)y;
+
+    CompFileHeader h;
+    comp_layout(h, nrows, nbins);
+
+    std::FILE* out = std::fopen(archive_file, "wb");
+    if(!out) comp_fail("cannot create", archive_file);
+
+    std::vector<char> zero(h.off_bins, 0);
+    std::memcpy(&zero[0], &h, sizeof(h));
+    bool ok = std::fwrite(&zero[0], 1, zero.size(), out) == zero.size();
+
+    dvector row(1,nbins);
+    for(int i = 1; i <= nbins; i++)
+    {
+        if(!comp_next(in, row(i))) comp_fail("expected the bin midpoints in", text_file);
+    }
+    ok = ok && std::fwrite(&row(1), sizeof(double), nbins, out) == (size_t)nbins;
+
+    std::vector<int32_t> year(nrows), fleet(nrows);
+    std::vector<double>  sum(nrows), lnfact(nrows);
+    ok = ok && comp_seek(out, h.off_obs);
+    for(int64_t r = 0; r < nrows && ok; r++)
+    {
+        if(!comp_next(in, x) || !comp_next(in, y)) comp_fail("expected more rows in", text_file);
+        year[r]  = (int32_t)x;
+        fleet[r] = (int32_t)y;
+        double n = 0.;
+        for(int i = 1; i <= nbins; i++)
+        {
+            if(!comp_next(in, row(i))) comp_fail("expected more rows in", text_file);
+            n += row(i);
+        }
+        sum[r]    = n;
+        lnfact[r] = dpois_lnfact(row);
+        ok = std::fwrite(&row(1), sizeof(double), nbins, out) == (size_t)nbins;
+    }
+
+    if(nrows == 0)
+    {
+        // no observations: extend the file to the end of the last (empty) section
+        // by writing its final byte, unless the bin midpoints already reach it
+        char pad = 0;
+        if(h.bytes > h.off_bins + nbins * (int64_t)sizeof(double))
+        {
+            ok = ok && comp_seek(out, h.bytes - 1) && std::fwrite(&pad, 1, 1, out) == 1;
+        }
+    }
+    else
+    {
+        ok = ok && comp_seek(out, h.off_year)   && std::fwrite(&year[0],   sizeof(int32_t), nrows, out) == (size_t)nrows;
+        ok = ok && comp_seek(out, h.off_fleet)  && std::fwrite(&fleet[0],  sizeof(int32_t), nrows, out) == (size_t)nrows;
+        ok = ok && comp_seek(out, h.off_sum)    && std::fwrite(&sum[0],    sizeof(double),  nrows, out) == (size_t)nrows;
+        ok = ok && comp_seek(out, h.off_lnfact) && std::fwrite(&lnfact[0], sizeof(double),  nrows, out) == (size_t)nrows;
+    }
+    ok = (std::fclose(out) == 0) && ok;
+    if(!ok) comp_fail("cannot write", archive_file);
+}
+
+// =========================================================================================================
@@ -15,22 +15,208 @@
 
 dvar_vector dgamma(const dvector& x, const dvariable& a, const dvariable& b)
   {
+    CSTAR_SCOPE_N("dgamma", x);
     //returns the gamma density with a & b as parameters
-    RETURN_ARRAYS_INCREMENT();
-    dvariable t1 = 1./(pow(b,a)*mfexp(gammln(a)));
-    dvar_vector t2 = (a-1.)*log(x)-x/b;
-    RETURN_ARRAYS_DECREMENT();
-    return(t1*mfexp(t2));
+    return(mfexp(ldgamma(x,a,b)));
   }
 
 dvariable dgamma(const prevariable& x, const double& a, const double& b)
   {
+    CSTAR_SCOPE("dgamma");
     //returns the gamma density with a & b as parameters
     RETURN_ARRAYS_INCREMENT();
-    dvariable t1 = 1./(pow(b,a)*mfexp(gammln(a)));
-    dvariable t2 = (a-1.)*log(x)-x/b;
+    double lnc   = a*log(b)+cstar::lgammafn(a);
+    dvariable t2 = (a-1.)*log(x)-x/b-lnc;
     RETURN_ARRAYS_DECREMENT();
-    return(t1*mfexp(t2));
+    return(mfexp(t2));
+  }
+
+// Double versions: no derivative information, nothing written to the gradient stack.
+
+double dgamma(const double& x, const double& a, const double& b)
+  {
+    CSTAR_SCOPE("dgamma");
+    return(exp(ldgamma(x,a,b)));
+  }
+
+dvector dgamma(const dvector& x, const double& a, const double& b)
+  {
+    CSTAR_SCOPE_N("dgamma", x);
+    return(exp(ldgamma(x,a,b)));
   }
 
 // =========================================================================================================
+// ldgamma(): log of the gamma density with shape a and scale b,
+//            (a-1)*log(x) - x/b - (a*log(b) + lgamma(a)), with analytic derivatives
+// =========================================================================================================
+
+/*
+ * Adjoint of the vector ldgamma(): with df = dfld,
+ *   dld/da = log(x) - log(b) - psi(a),  dld/db = x/b^2 - a/b,  dld/dx = (a-1)/x - 1/b.
+ * The x derivatives are only scattered when x is a dvar_vector.
+ */
+static void df_ldgamma(void)
+{
+    verify_identifier_string("CSlg2");
+    int xvar                    = restore_int_value();
+    double bv                   = restore_double_value();
+    double av                   = restore_double_value();
+    dvector_position xpos       = restore_dvector_position();
+    dvector x                   = restore_dvector_value(xpos);
+    prevariable_position bpos   = restore_prevariable_position();
+    prevariable_position apos   = restore_prevariable_position();
+    dvar_vector_position ldpos  = restore_dvar_vector_position();
+    dvector dfld                = restore_dvar_vector_derivatives(ldpos);
+
+    double lnb  = log(bv);
+    double psia = cstar::digamma(av);
+    double dfa  = 0.;
+    double dfb  = 0.;
+    for(int i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        dfa += dfld(i)*(log(x(i))-lnb-psia);
+        dfb += dfld(i)*(x(i)/bv-av)/bv;
+    }
+    save_double_derivative(dfa, apos);
+    save_double_derivative(dfb, bpos);
+
+    if(xvar)
+    {
+        dvar_vector_position xvpos = restore_dvar_vector_position();
+        dvector dfx(x.indexmin(),x.indexmax());
+        for(int i = x.indexmin(); i <= x.indexmax(); i++)
+        {
+            dfx(i) = dfld(i)*((av-1.)/x(i)-1./bv);
+        }
+        dfx.save_dvector_derivatives(xvpos);
+    }
+    verify_identifier_string("CSlg1");
+}
+
+/*
+ * Forward pass shared by the vector overloads; xvar points to x when it is a
+ * dvar_vector so that its position is recorded as well.
+ */
+static dvar_vector ldgamma_vector(const dvector& x, const dvar_vector* xvar,
+                                  const prevariable& a, const prevariable& b)
+{
+    double av  = value(a);
+    double bv  = value(b);
+    double lnc = av*log(bv)+cstar::lgammafn(av);
+    dvector ld(x.indexmin(),x.indexmax());
+    for(int i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        ld(i) = (av-1.)*log(x(i))-x(i)/bv-lnc;
+    }
+
+    dvar_vector vld = nograd_assign(ld);
+    save_identifier_string("CSlg1");
+    if(xvar) xvar->save_dvar_vector_position();
+    vld.save_dvar_vector_position();
+    a.save_prevariable_position();
+    b.save_prevariable_position();
+    x.save_dvector_value();
+    x.save_dvector_position();
+    save_double_value(av);
+    save_double_value(bv);
+    save_int_value(xvar ? 1 : 0);
+    save_identifier_string("CSlg2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_ldgamma);
+    return vld;
+}
+
+dvar_vector ldgamma(const dvector& x, const prevariable& a, const prevariable& b)
+{
+    CSTAR_SCOPE_N("ldgamma", x);
+    return ldgamma_vector(x, 0, a, b);
+}
+
+dvar_vector ldgamma(const dvar_vector& x, const prevariable& a, const prevariable& b)
+{
+    CSTAR_SCOPE_N("ldgamma", x);
+    return ldgamma_vector(value(x), &x, a, b);
+}
+
+// ------------------------------------------------------------------------------------ //
+
+/*
+ * Adjoint of the scalar ldgamma(); same partial derivatives as df_ldgamma().
+ */
+static void df_ldgamma_scalar(void)
+{
+    verify_identifier_string("CSls2");
+    int xvar                    = restore_int_value();
+    double xv                   = restore_double_value();
+    double bv                   = restore_double_value();
+    double av                   = restore_double_value();
+    prevariable_position bpos   = restore_prevariable_position();
+    prevariable_position apos   = restore_prevariable_position();
+    prevariable_position ldpos  = restore_prevariable_position();
+    double dfld                 = restore_prevariable_derivative(ldpos);
+
+    save_double_derivative(dfld*(log(xv)-log(bv)-cstar::digamma(av)), apos);
+    save_double_derivative(dfld*(xv/bv-av)/bv, bpos);
+    if(xvar)
+    {
+        prevariable_position xpos = restore_prevariable_position();
+        save_double_derivative(dfld*((av-1.)/xv-1./bv), xpos);
+    }
+    verify_identifier_string("CSls1");
+}
+
+static dvariable ldgamma_scalar(const double& xv, const prevariable* xvar,
+                                const prevariable& a, const prevariable& b)
+{
+    double av = value(a);
+    double bv = value(b);
+
+    dvariable vld = nograd_assign((av-1.)*log(xv)-xv/bv-(av*log(bv)+cstar::lgammafn(av)));
+    save_identifier_string("CSls1");
+    if(xvar) xvar->save_prevariable_position();
+    vld.save_prevariable_position();
+    a.save_prevariable_position();
+    b.save_prevariable_position();
+    save_double_value(av);
+    save_double_value(bv);
+    save_double_value(xv);
+    save_int_value(xvar ? 1 : 0);
+    save_identifier_string("CSls2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_ldgamma_scalar);
+    return vld;
+}
+
+dvariable ldgamma(const double& x, const prevariable& a, const prevariable& b)
+{
+    CSTAR_SCOPE("ldgamma");
+    return ldgamma_scalar(x, 0, a, b);
+}
+
+dvariable ldgamma(const prevariable& x, const prevariable& a, const prevariable& b)
+{
+    CSTAR_SCOPE("ldgamma");
+    return ldgamma_scalar(value(x), &x, a, b);
+}
+
+// =========================================================================================================
+
+// Double versions of ldgamma(): the log density only.
+
+double ldgamma(const double& x, const double& a, const double& b)
+{
+    CSTAR_SCOPE("ldgamma");
+    return (a-1.)*log(x)-x/b-(a*log(b)+cstar::lgammafn(a));
+}
+
+dvector ldgamma(const dvector& x, const double& a, const double& b)
+{
+    CSTAR_SCOPE_N("ldgamma", x);
+    double lnc = a*log(b)+cstar::lgammafn(a);
+    dvector ld(x.indexmin(),x.indexmax());
+    for(int i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        ld(i) = (a-1.)*log(x(i))-x(i)/b-lnc;
+    }
+    return ld;
+}
+
+// =========================================================================================================
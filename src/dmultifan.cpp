@@ -12,43 +12,165 @@
 #include "../include/cstar.h"
 
 // =========================================================================================================
-  
+
+/*
+ * Adjoint of dmultifan(): g holds dnll/dP for the normalized predictions
+ * P = p/sum(p); the reverse sweep chains it through the normalization,
+ * dnll/dp(i) = (g(i) - sum(g*P)) / sum(p).
+ */
+static void df_dmultifan(void)
+{
+    verify_identifier_string("CSmf2");
+    double sump                 = restore_double_value();
+    double gP                   = restore_double_value();
+    dvector_position gpos       = restore_dvector_position();
+    dvector g                   = restore_dvector_value(gpos);
+    dvar_vector_position ppos   = restore_dvar_vector_position();
+    prevariable_position nllpos = restore_prevariable_position();
+    double dfnll                = restore_prevariable_derivative(nllpos);
+    verify_identifier_string("CSmf1");
+
+    dvector dfp(g.indexmin(),g.indexmax());
+    for(int i = g.indexmin(); i <= g.indexmax(); i++)
+    {
+        dfp(i) = dfnll * (g(i) - gP) / sump;
+    }
+    dfp.save_dvector_derivatives(ppos);
+}
+
+/*
+ * Negative log-likelihood shared by the dmultifan() overloads: o points at the
+ * observed number for pv.indexmin() and n is their sum, so that the observed
+ * proportions o/n are formed on the fly from a dvector or a CompRow, and
+ * tau = 1/min(n,s) is the inverse of the capped sample size. When g is not
+ * null it receives dnll/dP, and gP and sump the terms the adjoint needs to
+ * chain through the normalization.
+ */
+static double dmultifan_value(const double* o, const double& n, const dvector& pv, const double& tau,
+                              dvector* g, double* gP, double* sump)
+{
+    int lb     = pv.indexmin();
+    int nb     = pv.indexmax();
+    int I      = (nb-lb)+1;
+    double c   = 0.1/I;
+
+    // Normalize, accumulate T1 and T3, and the gradient with respect to P in one loop
+    double sp = sum(pv);
+    double T1 = 0., T2, T3 = 0.;
+    if(g) *gP = 0.;
+    for(int i = lb; i <= nb; i++)
+    {
+        double P   = pv(i)/sp;
+        double eps = (1.-P)*P + c;
+        double res = o[i-lb]/n-P;
+        double q   = res*res/(2.*tau*eps);
+        double E   = exp(-q);
+        T1 += log(2.*M_PI*eps);
+        T3 += log(E+0.01);
+
+        if(g)
+        {
+            double dq = -res/(tau*eps) - res*res*(1.-2.*P)/(2.*tau*eps*eps);
+            (*g)(i) = 0.5*(1.-2.*P)/eps + E/(E+0.01)*dq;
+            *gP    += (*g)(i)*P;
+        }
+    }
+    T1 = -0.5 * T1;
+    T2 = -0.5 * I * log(tau);
+    if(sump) *sump = sp;
+    return -1.0*(T1 + T2 + T3);
+}
+
+/*
+ * Kernel shared by the dvar dmultifan() overloads: one derivative record.
+ */
+static dvariable dmultifan_kernel(const double* o, const double& n, const dvar_vector& p, const double& tau)
+{
+    dvector g(p.indexmin(),p.indexmax());
+    double gP, sump;
+    dvariable nll = nograd_assign(dmultifan_value(o, n, value(p), tau, &g, &gP, &sump));
+    save_identifier_string("CSmf1");
+    nll.save_prevariable_position();
+    p.save_dvar_vector_position();
+    g.save_dvector_value();
+    g.save_dvector_position();
+    save_double_value(gP);
+    save_double_value(sump);
+    save_identifier_string("CSmf2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_dmultifan);
+    return nll;
+}
+
 dvariable dmultifan(const dvector& o, const dvar_vector& p, const double& s)
 {
+    CSTAR_SCOPE_N("dmultifan", o);
     /*
     o is the observed numbers at length
     p is the predicted numbers at length
     s is the minimum sample size
     */
-    RETURN_ARRAYS_INCREMENT();      
-    int lb     = o.indexmin();
-    int nb     = o.indexmax();
-    int I      = (nb-lb)+1;
     double n   = sum(o);
     if(min(n,s)<=0)
     {
-        RETURN_ARRAYS_DECREMENT();
         return(0);
     } 
-    double tau = 1./min(n,s);
+    return dmultifan_kernel(o.get_v() + o.indexmin(), n, p, 1./min(n,s));
+}
 
-    dvariable nll;
-    dvector O     = o/sum(o);
-    dvar_vector P = p/sum(p);
-    dvar_vector epsilon(lb,nb);
-    epsilon       = elem_prod(1.-P,P);
+dvariable dmultifan(const ObsVector& o, const dvar_vector& p)
+{
+    CSTAR_SCOPE_N("dmultifan", o);
+    // o holds the observed numbers at length, their proportions and the capped sample size
+    if(o.SampleSize()<=0)
+    {
+        return(0);
+    }
+    return dmultifan_kernel(o.Obs().get_v() + o.indexmin(), o.Sum(), p, 1./o.SampleSize());
+}
 
-    dvariable T1,T2,T3;
-    T1 = -0.5 * sum(log( 2.*M_PI*(epsilon+0.1/I) ));
-    T2 = -0.5 * I * log(tau);
-    T3 = sum( log(exp(-1.0 * elem_div(square(O-P),2.0*tau*(epsilon+0.1/I)) )+0.01) );
-    
-    nll = -1.0*(T1 + T2 + T3);
-    
-    //cout<<"dmultifan like = "<<nll<<"\tn = "<<1./tau<<"\tsum(P) = "<<sum(O)<<endl;
-    //if(n==112) cout<<p<<endl;
-    RETURN_ARRAYS_DECREMENT();
-    return nll;
+dvariable dmultifan(const CompRow& o, const dvar_vector& p)
+{
+    CSTAR_SCOPE_N("dmultifan", o);
+    if(o.SampleSize()<=0)
+    {
+        return(0);
+    }
+    return dmultifan_kernel(o.Data(), o.Sum(), p, 1./o.SampleSize());
+}
+
+// ------------------------------------------------------------------------------------ //
+
+// Double versions: no derivative information, nothing written to the gradient stack.
+
+double dmultifan(const dvector& o, const dvector& p, const double& s)
+{
+    CSTAR_SCOPE_N("dmultifan", o);
+    double n   = sum(o);
+    if(min(n,s)<=0)
+    {
+        return(0);
+    }
+    return dmultifan_value(o.get_v() + o.indexmin(), n, p, 1./min(n,s), 0, 0, 0);
+}
+
+double dmultifan(const ObsVector& o, const dvector& p)
+{
+    CSTAR_SCOPE_N("dmultifan", o);
+    if(o.SampleSize()<=0)
+    {
+        return(0);
+    }
+    return dmultifan_value(o.Obs().get_v() + o.indexmin(), o.Sum(), p, 1./o.SampleSize(), 0, 0, 0);
+}
+
+double dmultifan(const CompRow& o, const dvector& p)
+{
+    CSTAR_SCOPE_N("dmultifan", o);
+    if(o.SampleSize()<=0)
+    {
+        return(0);
+    }
+    return dmultifan_value(o.Data(), o.Sum(), p, 1./o.SampleSize(), 0, 0, 0);
 }
 
 // =========================================================================================================
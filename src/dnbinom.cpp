@@ -12,31 +12,172 @@
 #include "../include/cstar.h"
 
 // =========================================================================================================
-  
-dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k)
+
+/*
+ * Adjoint of dnbinom(): the gradients with respect to mu and k were computed
+ * in the forward pass, so the reverse sweep only scales them by dfnll.
+ */
+static void df_dnbinom(void)
+{
+    verify_identifier_string("CSnb2");
+    double dk                  = restore_double_value();
+    dvector_position dmupos    = restore_dvector_position();
+    dvector dmu                = restore_dvector_value(dmupos);
+    prevariable_position kpos  = restore_prevariable_position();
+    dvar_vector_position mupos = restore_dvar_vector_position();
+    prevariable_position nllpos = restore_prevariable_position();
+    double dfnll               = restore_prevariable_derivative(nllpos);
+    verify_identifier_string("CSnb1");
+
+    dvector dfmu = dfnll * dmu;
+    dfmu.save_dvector_derivatives(mupos);
+    save_double_derivative(dfnll * dk, kpos);
+}
+
+/*
+ * Negative log-likelihood shared by the double and dvar overloads; xp points
+ * at the count for muv.indexmin(), so that it can be a dvector or a CompRow.
+ * When dmu is not null it also receives the gradients with respect to mu, and
+ * dk the gradient with respect to k. The k-only terms are hoisted out of the loop.
+ */
+static double dnbinom_value(const double* xp, const dvector& muv, const double& kv,
+                            const double& lnfact, dvector* dmu, double* dk)
 {
+    int i,imin,imax;
+    imin=muv.indexmin();
+    imax=muv.indexmax();
+
+    double lgk     = cstar::lgammafn(kv);
+    double klogk   = kv*log(kv);
+    double loglike = -lnfact;
+
+    // batch lgamma of k+x, and digamma only when the gradient is wanted
+    dvector kx(imin,imax);
+    for(i = imin; i<=imax; i++) kx(i) = kv+xp[i-imin];
+    dvector lgkx   = cstar::lgammafn(kx);
+    dvector psikx;
+    double psik    = 0.;
+    if(dmu)
+    {
+        psikx = cstar::digamma(kx);
+        psik  = cstar::digamma(kv);
+        *dk   = 0.;
+    }
+
+    for(i = imin; i<=imax; i++)
+    {
+        double m     = muv(i);
+        double xi    = xp[i-imin];
+        double logmk = log(m+kv);
+        loglike += lgkx(i)-lgk+klogk-kx(i)*logmk;
+        if(xi>0.0) loglike += xi*log(m);
+
+        // derivatives of -loglike
+        if(dmu)
+        {
+            (*dmu)(i) = kx(i)/(m+kv)-xi/m;
+            *dk      -= psikx(i)-psik+log(kv)+1.-logmk-kx(i)/(m+kv);
+        }
+    }
+    return -loglike;
+}
+
+/*
+ * Kernel shared by the dvar dnbinom() overloads: value and analytic gradients
+ * together, in one derivative record.
+ */
+static dvariable dnbinom_kernel(const double* x, const dvar_vector& mu, const prevariable& k,
+                                const double& lnfact)
+{
+    double dk = 0.;
+    dvector dmu(mu.indexmin(),mu.indexmax());
+    dvariable nll = nograd_assign(dnbinom_value(x, value(mu), value(k), lnfact, &dmu, &dk));
+    save_identifier_string("CSnb1");
+    nll.save_prevariable_position();
+    mu.save_dvar_vector_position();
+    k.save_prevariable_position();
+    dmu.save_dvector_value();
+    dmu.save_dvector_position();
+    save_double_value(dk);
+    save_identifier_string("CSnb2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_dnbinom);
+    return(nll);
+}
+
+dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k, const double& lnfact)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
     //the observed counts are in x
     //mu is the predicted mean
     //k is the overdispersion parameter
+    //lnfact = dpois_lnfact(x) is the data-only term sum(log(x!))
     if (value(k)<0.0)
     {
         cerr<<"k is <=0.0 in dnbinom()";
         return(0.0);
     }
-    RETURN_ARRAYS_INCREMENT();
-    int i,imin,imax;
-    imin=x.indexmin();
-    imax=x.indexmax();
-    dvariable loglike = 0.;
+    return dnbinom_kernel(x.get_v() + x.indexmin(), mu, k, lnfact);
+}
 
-    for(i = imin; i<=imax; i++)
+dvariable dnbinom(const dvector& x, const dvar_vector& mu, const prevariable& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    return dnbinom(x, mu, k, dpois_lnfact(x));
+}
+
+dvariable dnbinom(const ObsVector& x, const dvar_vector& mu, const prevariable& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    return dnbinom(x.Obs(), mu, k, x.LnFact());
+}
+
+dvariable dnbinom(const CompRow& x, const dvar_vector& mu, const prevariable& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    if (value(k)<0.0)
+    {
+        cerr<<"k is <=0.0 in dnbinom()";
+        return(0.0);
+    }
+    return dnbinom_kernel(x.Data(), mu, k, x.LnFact());
+}
+
+// ------------------------------------------------------------------------------------ //
+
+// Double versions: no derivative information, nothing written to the gradient stack.
+
+double dnbinom(const dvector& x, const dvector& mu, const double& k, const double& lnfact)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    if (k<0.0)
     {
-        cout<<"mu "<<mu(i)<<endl;
-        loglike += gammln(k+x(i))-gammln(k)-gammln(x(i)+1)+k*log(k)-k*log(mu(i)+k)+x(i)*log(mu(i))-x(i)*log(mu(i)+k);
+        cerr<<"k is <=0.0 in dnbinom()";
+        return(0.0);
+    }
+    return dnbinom_value(x.get_v() + x.indexmin(), mu, k, lnfact, 0, 0);
+}
+
+double dnbinom(const dvector& x, const dvector& mu, const double& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    return dnbinom(x, mu, k, dpois_lnfact(x));
+}
+
+double dnbinom(const ObsVector& x, const dvector& mu, const double& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    return dnbinom(x.Obs(), mu, k, x.LnFact());
+}
+
+double dnbinom(const CompRow& x, const dvector& mu, const double& k)
+{
+    CSTAR_SCOPE_N("dnbinom", x);
+    if (k<0.0)
+    {
+        cerr<<"k is <=0.0 in dnbinom()";
+        return(0.0);
     }
-    RETURN_ARRAYS_DECREMENT();
-    return(-loglike);
+    return dnbinom_value(x.Data(), mu, k, x.LnFact(), 0, 0);
 }
 
 // =========================================================================================================
-  
\ No newline at end of file
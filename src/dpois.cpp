@@ -13,18 +13,122 @@
 
 // =========================================================================================================
 
-dvariable dpois(const dvector& k, const dvar_vector& lambda)
+// dpois_lnfact(): Data-only term sum(log(k!)) of the Poisson likelihood; compute once per data vector.
+
+double dpois_lnfact(const dvector& k)
+{
+    CSTAR_SCOPE_N("dpois_lnfact", k);
+    return sum(cstar::lgammafn(k+1.));
+}
+
+// ------------------------------------------------------------------------------------ //
+
+/*
+ * Adjoint of dpois(): dnll/dlambda = 1 - k/lambda was computed in the
+ * forward pass, so the reverse sweep only scales it by dfnll.
+ */
+static void df_dpois(void)
+{
+    verify_identifier_string("CSpo2");
+    dvector_position dlampos    = restore_dvector_position();
+    dvector dlam                = restore_dvector_value(dlampos);
+    dvar_vector_position lampos = restore_dvar_vector_position();
+    prevariable_position nllpos = restore_prevariable_position();
+    double dfnll                = restore_prevariable_derivative(nllpos);
+    verify_identifier_string("CSpo1");
+
+    dvector dflam = dfnll * dlam;
+    dflam.save_dvector_derivatives(lampos);
+}
+
+/*
+ * Negative log-likelihood shared by the double and dvar overloads; k points at
+ * the count for lambda.indexmin(), so that it can be a dvector or a CompRow.
+ * When dlam is not null it also receives the gradient 1 - k/lambda.
+ */
+static double dpois_value(const double* k, const dvector& lam, const double& lnfact, dvector* dlam)
 {
-    RETURN_ARRAYS_INCREMENT();
-    int i;
-    int n = size_count(k);
-    dvariable nll=0;
-    for(i = 1; i <= n; i++)
+    int lb = lam.indexmin();
+    double loglike = -lnfact;
+    for(int i = lb; i <= lam.indexmax(); i++)
     {
-        nll -= k(i)*log(lambda(i))+lambda(i)+gammln(k(i)+1.);
+        double ki = k[i-lb];
+        loglike -= lam(i);
+        if(ki>0.0) loglike += ki*log(lam(i));
+        if(dlam) (*dlam)(i) = 1.-ki/lam(i);
     }
-    RETURN_ARRAYS_DECREMENT();
+    return -loglike;
+}
+
+/*
+ * Kernel shared by the dvar dpois() overloads: one derivative record.
+ */
+static dvariable dpois_kernel(const double* k, const dvar_vector& lambda, const double& lnfact)
+{
+    dvector dlam(lambda.indexmin(),lambda.indexmax());
+    dvariable nll = nograd_assign(dpois_value(k, value(lambda), lnfact, &dlam));
+    save_identifier_string("CSpo1");
+    nll.save_prevariable_position();
+    lambda.save_dvar_vector_position();
+    dlam.save_dvector_value();
+    dlam.save_dvector_position();
+    save_identifier_string("CSpo2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_dpois);
     return nll;
 }
 
+dvariable dpois(const dvector& k, const dvar_vector& lambda, const double& lnfact)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    // k are the observed counts, lambda the predicted means,
+    // lnfact = dpois_lnfact(k) is the cached data-only term
+    return dpois_kernel(k.get_v() + k.indexmin(), lambda, lnfact);
+}
+
+dvariable dpois(const dvector& k, const dvar_vector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois(k, lambda, dpois_lnfact(k));
+}
+
+dvariable dpois(const ObsVector& k, const dvar_vector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois(k.Obs(), lambda, k.LnFact());
+}
+
+dvariable dpois(const CompRow& k, const dvar_vector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois_kernel(k.Data(), lambda, k.LnFact());
+}
+
+// ------------------------------------------------------------------------------------ //
+
+// Double versions: no derivative information, nothing written to the gradient stack.
+
+double dpois(const dvector& k, const dvector& lambda, const double& lnfact)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois_value(k.get_v() + k.indexmin(), lambda, lnfact, 0);
+}
+
+double dpois(const dvector& k, const dvector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois_value(k.get_v() + k.indexmin(), lambda, dpois_lnfact(k), 0);
+}
+
+double dpois(const ObsVector& k, const dvector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois_value(k.Obs().get_v() + k.indexmin(), lambda, k.LnFact(), 0);
+}
+
+double dpois(const CompRow& k, const dvector& lambda)
+{
+    CSTAR_SCOPE_N("dpois", k);
+    return dpois_value(k.Data(), lambda, k.LnFact(), 0);
+}
+
 // =========================================================================================================
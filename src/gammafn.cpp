@@ -0,0 +1,212 @@
+/**
+*
+* \file gammafn.cpp
+* \brief Gamma-related special functions
+* \ingroup CSTAR
+*
+*  Log gamma and digamma functions for x > 0, for scalars and whole vectors.
+*  Integer arguments up to LGAMMA_TABLE_MAX (observed counts, log factorials)
+*  are read from a table. Arguments below 10 are shifted up by a fixed
+*  amount, and everything else is evaluated with the Stirling series, so
+*  the inner loops have no data-dependent iteration counts.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#define LGAMMA_TABLE_MAX 256
+#define LGAMMA_SHIFT     10
+
+// =========================================================================================================
+
+// Tables of lgamma(n) = log((n-1)!) and digamma(n) = -euler + sum(1/k, k < n) for n = 1, ..., LGAMMA_TABLE_MAX.
+struct GammaTables
+{
+    double lgamma[LGAMMA_TABLE_MAX + 1];
+    double digamma[LGAMMA_TABLE_MAX + 1];
+
+    GammaTables()
+    {
+        lgamma[0]  = 0.;
+        digamma[0] = 0.;
+        lgamma[1]  = 0.;
+        digamma[1] = -0.57721566490153286061;
+        for(int n = 2; n <= LGAMMA_TABLE_MAX; n++)
+        {
+            lgamma[n]  = lgamma[n-1] + log(double(n-1));
+            digamma[n] = digamma[n-1] + 1./(n-1);
+        }
+    }
+};
+
+// Built on first use, so callers in other translation units may use them during static initialization
+static const GammaTables& gamma_tables()
+{
+    static const GammaTables t;
+    return t;
+}
+
+/* Index into the tables, or 0 if x is not a tabulated integer. */
+static inline int gamma_table_index(const double& x)
+{
+    if(x >= 1. && x <= LGAMMA_TABLE_MAX && x == floor(x)) return int(x);
+    return 0;
+}
+
+/* Stirling series for lgamma, after shifting x < 10 up by LGAMMA_SHIFT. */
+static inline double lgamma_stirling(const double& x)
+{
+    double z = x;
+    double c = 0.;
+    if(x < LGAMMA_SHIFT)
+    {
+        double p = 1.;
+        for(int k = 0; k < LGAMMA_SHIFT; k++) p *= x + k;
+        z = x + LGAMMA_SHIFT;
+        c = log(p);
+    }
+    double r  = 1./z;
+    double r2 = r*r;
+    double s  = (z-0.5)*log(z) - z + 0.91893853320467274178
+              + r*(1./12. - r2*(1./360. - r2*(1./1260. - r2*(1./1680. - r2*(1./1188.)))));
+    return s - c;
+}
+
+/* Asymptotic series for digamma, after shifting x < 10 up by LGAMMA_SHIFT. */
+static inline double digamma_stirling(const double& x)
+{
+    double z = x;
+    double h = 0.;
+    if(x < LGAMMA_SHIFT)
+    {
+        for(int k = 0; k < LGAMMA_SHIFT; k++) h += 1./(x + k);
+        z = x + LGAMMA_SHIFT;
+    }
+    double r  = 1./z;
+    double r2 = r*r;
+    double s  = log(z) - 0.5*r
+              - r2*(1./12. - r2*(1./120. - r2*(1./252. - r2*(1./240. - r2*(1./132.)))));
+    return s - h;
+}
+
+// =========================================================================================================
+// lgammafn(): log gamma function, for x > 0.
+// =========================================================================================================
+
+double cstar::lgammafn(const double& x)
+{
+    int n = gamma_table_index(x);
+    return n ? gamma_tables().lgamma[n] : lgamma_stirling(x);
+}
+
+dvector cstar::lgammafn(const dvector& x)
+{
+    CSTAR_SCOPE_N("lgammafn", x);
+    int i;
+    const double* table = gamma_tables().lgamma;
+    dvector y(x.indexmin(),x.indexmax());
+    for(i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        y(i) = lgamma_stirling(x(i));
+    }
+    for(i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        int n = gamma_table_index(x(i));
+        if(n) y(i) = table[n];
+    }
+    return y;
+}
+
+/*
+ * Adjoint of lgammafn(): dlgamma(x)/dx = digamma(x), saved in the forward pass.
+ */
+static void df_lgammafn(void)
+{
+    verify_identifier_string("CSlf2");
+    dvector_position psipos    = restore_dvector_position();
+    dvector psi                = restore_dvector_value(psipos);
+    dvar_vector_position ypos  = restore_dvar_vector_position();
+    dvector dfy                = restore_dvar_vector_derivatives(ypos);
+    dvar_vector_position xpos  = restore_dvar_vector_position();
+    verify_identifier_string("CSlf1");
+
+    dvector dfx(psi.indexmin(),psi.indexmax());
+    for(int i = psi.indexmin(); i <= psi.indexmax(); i++)
+    {
+        dfx(i) = dfy(i) * psi(i);
+    }
+    dfx.save_dvector_derivatives(xpos);
+}
+
+dvar_vector cstar::lgammafn(const dvar_vector& x)
+{
+    CSTAR_SCOPE_N("lgammafn", x);
+    dvector xv  = value(x);
+    dvector psi = cstar::digamma(xv);
+    dvar_vector y = nograd_assign(cstar::lgammafn(xv));
+    save_identifier_string("CSlf1");
+    x.save_dvar_vector_position();
+    y.save_dvar_vector_position();
+    psi.save_dvector_value();
+    psi.save_dvector_position();
+    save_identifier_string("CSlf2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_lgammafn);
+    return y;
+}
+
+static void df_lgammafn_scalar(void)
+{
+    verify_identifier_string("CSlF2");
+    double psi                 = restore_double_value();
+    prevariable_position ypos  = restore_prevariable_position();
+    double dfy                 = restore_prevariable_derivative(ypos);
+    prevariable_position xpos  = restore_prevariable_position();
+    verify_identifier_string("CSlF1");
+    save_double_derivative(dfy * psi, xpos);
+}
+
+dvariable cstar::lgammafn(const prevariable& x)
+{
+    CSTAR_SCOPE("lgammafn");
+    double xv   = value(x);
+    dvariable y = nograd_assign(cstar::lgammafn(xv));
+    save_identifier_string("CSlF1");
+    x.save_prevariable_position();
+    y.save_prevariable_position();
+    save_double_value(cstar::digamma(xv));
+    save_identifier_string("CSlF2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_lgammafn_scalar);
+    return y;
+}
+
+// =========================================================================================================
+// digamma(): derivative of the log gamma function, for x > 0.
+// =========================================================================================================
+
+double cstar::digamma(const double& x)
+{
+    int n = gamma_table_index(x);
+    return n ? gamma_tables().digamma[n] : digamma_stirling(x);
+}
+
+dvector cstar::digamma(const dvector& x)
+{
+    CSTAR_SCOPE_N("digamma", x);
+    int i;
+    const double* table = gamma_tables().digamma;
+    dvector y(x.indexmin(),x.indexmax());
+    for(i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        y(i) = digamma_stirling(x(i));
+    }
+    for(i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        int n = gamma_table_index(x(i));
+        if(n) y(i) = table[n];
+    }
+    return y;
+}
+
+// =========================================================================================================
@@ -17,13 +17,23 @@
 
 double mn_length(const dvector& pobs, const dvector& mlen)
 {
+  CSTAR_SCOPE_N("mn_length", pobs);
   double mobs = (pobs*mlen);
   return mobs;
 }
 
 double mn_length(const dvar_vector& pobs, const dvector& mlen)
 {
-  double mobs = value(pobs*mlen);
+  CSTAR_SCOPE_N("mn_length", pobs);
+  double mobs = value(pobs)*mlen;
+  return mobs;
+}
+
+double mn_length(const CompRow& obs, const dvector& mlen)
+{
+  CSTAR_SCOPE_N("mn_length", obs);
+  double mobs = 0.;
+  for(int i = obs.indexmin(); i <= obs.indexmax(); i++) mobs += obs.Prop(i)*mlen(i);
   return mobs;
 }
 
@@ -32,92 +42,465 @@ double mn_length(const dvar_vector& pobs, const dvector& mlen)
   
 double sd_length(const dvector& pobs, const dvector& len, const dvector& mlen)
 {
+  CSTAR_SCOPE_N("sd_length", pobs);
   double mobs = (pobs*len);
   double stmp = sqrt((elem_prod(mlen,mlen)*pobs) - mobs*mobs);
   return stmp;
 }
 
+double sd_length(const CompRow& obs, const dvector& len, const dvector& mlen)
+{
+  CSTAR_SCOPE_N("sd_length", obs);
+  double mobs = 0., m2 = 0.;
+  for(int i = obs.indexmin(); i <= obs.indexmax(); i++)
+  {
+    double p = obs.Prop(i);
+    mobs += p*len(i);
+    m2   += mlen(i)*mlen(i)*p;
+  }
+  return sqrt(m2 - mobs*mobs);
+}
+
 // ------------------------------------------------------------------------------------ //
 // norm_res(): Returns normalized residuals of composition data given sample size.
   
 dvector norm_res(const dvector& pred, const dvector& obs, double m)
 {
-  RETURN_ARRAYS_INCREMENT();
+  CSTAR_SCOPE_N("norm_res", pred);
   //pred = pred + 0.0001;
   //obs  = obs  + 0.0001;
   dvector nr(1,size_count(obs));
   nr = elem_div(obs-pred,sqrt(elem_prod(pred,(1.-pred))/m));
-  RETURN_ARRAYS_DECREMENT();
+  return nr;
+}
+
+dvector norm_res(const dvector& pred, const ObsVector& obs)
+{
+  CSTAR_SCOPE_N("norm_res", pred);
+  return norm_res(pred, obs.Prop(), obs.SampleSize());
+}
+
+dvector norm_res(const dvector& pred, const CompRow& obs)
+{
+  CSTAR_SCOPE_N("norm_res", pred);
+  double m = obs.SampleSize();
+  dvector nr(obs.indexmin(),obs.indexmax());
+  for(int i = obs.indexmin(); i <= obs.indexmax(); i++)
+  {
+    nr(i) = (obs.Prop(i)-pred(i))/sqrt(pred(i)*(1.-pred(i))/m);
+  }
   return nr;
 }
 
 // ------------------------------------------------------------------------------------ //
 // sd_norm_res(): Computes standard deviation of normalized residuals given observed and predicted proportions.
 
-double sd_norm_res(const dvar_vector& pred, const dvector& obs, double m)
+double sd_norm_res(const dvector& pred, const dvector& obs, double m)
 {
-  RETURN_ARRAYS_INCREMENT();
+  CSTAR_SCOPE_N("sd_norm_res", pred);
   double sdnr;
-  dvector pp = value(pred)+ 0.0001;
+  dvector pp = pred + 0.0001;
   sdnr = std_dev(norm_res(pp,obs,m));
-  RETURN_ARRAYS_DECREMENT();
   return sdnr;
 }
 
+double sd_norm_res(const dvar_vector& pred, const dvector& obs, double m)
+{
+  CSTAR_SCOPE_N("sd_norm_res", pred);
+  return sd_norm_res(value(pred), obs, m);
+}
+
+double sd_norm_res(const dvector& pred, const ObsVector& obs)
+{
+  CSTAR_SCOPE_N("sd_norm_res", pred);
+  return sd_norm_res(pred, obs.Prop(), obs.SampleSize());
+}
+
+double sd_norm_res(const dvar_vector& pred, const ObsVector& obs)
+{
+  CSTAR_SCOPE_N("sd_norm_res", pred);
+  return sd_norm_res(value(pred), obs.Prop(), obs.SampleSize());
+}
+
+double sd_norm_res(const dvector& pred, const CompRow& obs)
+{
+  CSTAR_SCOPE_N("sd_norm_res", pred);
+  return std_dev(norm_res(pred + 0.0001, obs));
+}
+
+double sd_norm_res(const dvar_vector& pred, const CompRow& obs)
+{
+  CSTAR_SCOPE_N("sd_norm_res", pred);
+  return sd_norm_res(value(pred), obs);
+}
+
 // ------------------------------------------------------------------------------------ //
 // eff_N(): Computes effective sample size.
 
-double eff_N(const dvector& pobs, const dvar_vector& phat)
+double eff_N(const dvector& pobs, const dvector& phat)
 {
+  CSTAR_SCOPE_N("eff_N", pobs);
   // pobs += 0.0001;
   // phat += 0.0001;
-  dvar_vector rtmp = elem_div((pobs-phat),sqrt(elem_prod(phat,(1-phat))));
+  dvector rtmp = elem_div((pobs-phat),sqrt(elem_prod(phat,(1-phat))));
   double vtmp;
-  vtmp = value(norm2(rtmp)/size_count(rtmp));
+  vtmp = norm2(rtmp)/size_count(rtmp);
   return 1./vtmp;
 }
 
+double eff_N(const dvector& pobs, const dvar_vector& phat)
+{
+  CSTAR_SCOPE_N("eff_N", pobs);
+  return eff_N(pobs, value(phat));
+}
+
+double eff_N(const ObsVector& obs, const dvector& phat)
+{
+  CSTAR_SCOPE_N("eff_N", obs);
+  return eff_N(obs.Prop(), phat);
+}
+
+double eff_N(const ObsVector& obs, const dvar_vector& phat)
+{
+  CSTAR_SCOPE_N("eff_N", obs);
+  return eff_N(obs.Prop(), value(phat));
+}
+
+double eff_N(const CompRow& obs, const dvector& phat)
+{
+  CSTAR_SCOPE_N("eff_N", obs);
+  double ss = 0.;
+  for(int i = obs.indexmin(); i <= obs.indexmax(); i++)
+  {
+    double r = (obs.Prop(i)-phat(i))/sqrt(phat(i)*(1.-phat(i)));
+    ss += r*r;
+  }
+  return 1./(ss/(obs.indexmax()-obs.indexmin()+1));
+}
+
+double eff_N(const CompRow& obs, const dvar_vector& phat)
+{
+  CSTAR_SCOPE_N("eff_N", obs);
+  return eff_N(obs, value(phat));
+}
+
+// ------------------------------------------------------------------------------------ //
+// comp_diagnostics(): mn_length, sd_length, norm_res, sd_norm_res and eff_N for every row of a matrix.
+
+/*
+ * All five diagnostics for one composition in a single pass over its nb bins:
+ * o points at the observed numbers, divided by n to give proportions, p at the
+ * predicted proportions and mlen at the bin midpoints. The residuals go to res.
+ * As in sd_norm_res(), the sdnr is taken at pred+0.0001 with std_dev()'s
+ * population formula.
+ */
+static void comp_diagnostics_row(const double* o, const double& n, const double* p, const double* mlen,
+                                 int nb, const double& m, double* res, CompDiagnostics& out, int r)
+{
+    double mo = 0., mo2 = 0., mp = 0., mp2 = 0.;
+    double s  = 0., s2  = 0., q  = 0.;
+    for(int i = 0; i < nb; i++)
+    {
+        double oi = o[i]/n;
+        double pr = p[i];
+        double l  = mlen[i];
+        mo  += oi*l;
+        mo2 += l*l*oi;
+        mp  += pr*l;
+        mp2 += l*l*pr;
+
+        double d  = oi-pr;
+        double v  = pr*(1.-pr);
+        res[i]    = d/sqrt(v/m);
+        q        += d*d/v;
+
+        double pp = pr+0.0001;
+        double rr = (oi-pp)/sqrt(pp*(1.-pp)/m);
+        s  += rr;
+        s2 += rr*rr;
+    }
+    s  /= nb;
+    s2 /= nb;
+    out.mn_obs(r)  = mo;
+    out.mn_pred(r) = mp;
+    out.sd_obs(r)  = sqrt(mo2 - mo*mo);
+    out.sd_pred(r) = sqrt(mp2 - mp*mp);
+    out.sdnr(r)    = sqrt(s2 - s*s);
+    out.effN(r)    = 1./(q/nb);
+}
+
+// Size the results for rows r1..r2 and bins b1..b2, keeping storage that already fits
+static void comp_diagnostics_allocate(int r1, int r2, int b1, int b2, CompDiagnostics& out)
+{
+    if(allocated(out.effN) && out.effN.indexmin() == r1 && out.effN.indexmax() == r2
+       && allocated(out.res) && out.res.colmin() == b1 && out.res.colmax() == b2)
+    {
+        return;
+    }
+    dvector* v[] = {&out.mn_obs, &out.mn_pred, &out.sd_obs, &out.sd_pred, &out.sdnr, &out.effN};
+    for(int k = 0; k < 6; k++)
+    {
+        v[k]->deallocate();
+        v[k]->allocate(r1,r2);
+    }
+    out.res.deallocate();
+    out.res.allocate(r1,r2,b1,b2);
+}
+
+static void comp_diagnostics_fail(const char* what, int r)
+{
+    cerr << "comp_diagnostics: " << what << " (row " << r << ")" << endl;
+    ad_exit(1);
+}
+
+// The rows of pred must span the bins of mlen, as the row kernel reads them through raw pointers
+static void comp_diagnostics_check_row(const dvector& pred, int b1, int b2, int r)
+{
+    if(pred.indexmin() != b1 || pred.indexmax() != b2)
+        comp_diagnostics_fail("predicted bins do not match mlen", r);
+}
+
+void comp_diagnostics(const dmatrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen,
+                      CompDiagnostics& out)
+{
+    CSTAR_SCOPE_N("comp_diagnostics", pred);
+    int r1 = pred.rowmin();
+    int r2 = pred.rowmax();
+    int b1 = mlen.indexmin();
+    int b2 = mlen.indexmax();
+    if(obs.rowmin() > r1 || obs.rowmax() < r2)
+        comp_diagnostics_fail("observed rows do not cover the predicted rows", r1);
+    if(m.indexmin() > r1 || m.indexmax() < r2)
+        comp_diagnostics_fail("sample sizes do not cover the predicted rows", r1);
+    comp_diagnostics_allocate(r1, r2, b1, b2, out);
+    const double* l = mlen.get_v() + b1;
+    for(int r = r1; r <= r2; r++)
+    {
+        comp_diagnostics_check_row(pred(r), b1, b2, r);
+        if(obs(r).indexmin() != b1 || obs(r).indexmax() != b2)
+            comp_diagnostics_fail("observed bins do not match mlen", r);
+        comp_diagnostics_row(obs(r).get_v() + b1, 1., pred(r).get_v() + b1, l, b2-b1+1, m(r),
+                             out.res(r).get_v() + b1, out, r);
+    }
+}
+
+void comp_diagnostics(const dmatrix& pred, const CompArchive& obs, const dvector& mlen, CompDiagnostics& out)
+{
+    CSTAR_SCOPE_N("comp_diagnostics", pred);
+    int r1 = pred.rowmin();
+    int r2 = pred.rowmax();
+    int b1 = mlen.indexmin();
+    int b2 = mlen.indexmax();
+    if(obs.NumRows() < r2-r1+1)
+        comp_diagnostics_fail("archive has fewer rows than the predictions", obs.NumRows()+r1);
+    if(obs.NumBins() != b2-b1+1)
+        comp_diagnostics_fail("archive bins do not match mlen", r1);
+    comp_diagnostics_allocate(r1, r2, b1, b2, out);
+    const double* l = mlen.get_v() + b1;
+    for(int r = r1; r <= r2; r++)
+    {
+        comp_diagnostics_check_row(pred(r), b1, b2, r);
+        CompRow row = obs(r-r1+1);
+        double n = (row.Sum() > 0.) ? row.Sum() : 1.;
+        comp_diagnostics_row(row.Data(), n, pred(r).get_v() + b1, l, b2-b1+1, row.SampleSize(),
+                             out.res(r).get_v() + b1, out, r);
+    }
+}
+
+CompDiagnostics comp_diagnostics(const dmatrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen)
+{
+    CSTAR_SCOPE_N("comp_diagnostics", pred);
+    CompDiagnostics out;
+    comp_diagnostics(pred, obs, m, mlen, out);
+    return out;
+}
+
+CompDiagnostics comp_diagnostics(const dvar_matrix& pred, const dmatrix& obs, const dvector& m, const dvector& mlen)
+{
+    CSTAR_SCOPE_N("comp_diagnostics", pred);
+    return comp_diagnostics(value(pred), obs, m, mlen);
+}
+
+CompDiagnostics comp_diagnostics(const dmatrix& pred, const CompArchive& obs, const dvector& mlen)
+{
+    CSTAR_SCOPE_N("comp_diagnostics", pred);
+    CompDiagnostics out;
+    comp_diagnostics(pred, obs, mlen, out);
+    return out;
+}
+
 // ------------------------------------------------------------------------------------ //
 // posfun(): Return penalised positive values for some given vector.
+// Elements below eps are mapped to eps/(2-x/eps) and add 0.01*(x-eps)^2 to the penalty.
 
-dvar_vector posfun(const dvar_vector& x, const double& eps, dvariable& pen)
-  {
-    int i;
-    dvar_vector xp(x.indexmin(),x.indexmax());
-    for(i=x.indexmin();i<=x.indexmax();i++)
+/*
+ * Adjoint of posfun(): xp has slope one where x >= eps, so only the elements
+ * in the mask (those below eps) carry a saved slope dxp/dx and penalty
+ * gradient dpen/dx.
+ */
+static void df_posfun(void)
+{
+    verify_identifier_string("CSpf2");
+    int k = (int)restore_double_value();
+    ivector mask;
+    dvector slope, gpen;
+    if(k > 0)
+    {
+        dvector_position gpos  = restore_dvector_position();
+        gpen                   = restore_dvector_value(gpos);
+        dvector_position spos  = restore_dvector_position();
+        slope                  = restore_dvector_value(spos);
+        ivector_position mpos  = restore_ivector_position();
+        mask                   = restore_ivector_value(mpos);
+    }
+    prevariable_position ppos  = restore_prevariable_position();
+    double dfpen               = restore_prevariable_derivative(ppos);
+    dvar_vector_position xppos = restore_dvar_vector_position();
+    dvector dfx                = restore_dvar_vector_derivatives(xppos);
+    dvar_vector_position xpos  = restore_dvar_vector_position();
+    verify_identifier_string("CSpf1");
+
+    for(int j = 1; j <= k; j++)
+    {
+        int i  = mask(j);
+        dfx(i) = dfx(i)*slope(j) + dfpen*gpen(j);
+    }
+    dfx.save_dvector_derivatives(xpos);
+}
+
+/*
+ * Kernel shared by the dvar posfun() overloads: fills the allocated xp and
+ * returns the penalty of one vector in one pass, with one derivative record.
+ */
+static dvariable posfun_kernel(const dvar_vector& x, const double& eps, const dvar_vector& xp)
+{
+    dvector xv = value(x);
+    int lb = xv.indexmin();
+    int ub = xv.indexmax();
+    int k = 0;
+    double p = 0.;
+    for(int i = lb; i <= ub; i++)
     {
-        if(x(i)>=eps)
+        xp.elem_value(i) = xv(i);
+        if(xv(i) < eps)
         {
-            xp(i) = x(i);
+            double d = xv(i)-eps;
+            xp.elem_value(i) = eps/(2.-xv(i)/eps);
+            p += 0.01*d*d;
+            k++;
         }
-        else
+    }
+
+    dvariable vp = nograd_assign(p);
+    save_identifier_string("CSpf1");
+    x.save_dvar_vector_position();
+    xp.save_dvar_vector_position();
+    vp.save_prevariable_position();
+    if(k > 0)
+    {
+        ivector mask(1,k);
+        dvector slope(1,k);
+        dvector gpen(1,k);
+        for(int i = lb, j = 1; i <= ub; i++)
         {
-            pen += 0.01*square(x(i)-eps);
-            xp(i) = eps/(2.-x(i)/eps);
+            if(xv(i) >= eps) continue;
+            double r = 2.-xv(i)/eps;
+            mask(j)  = i;
+            slope(j) = 1./(r*r);
+            gpen(j)  = 0.02*(xv(i)-eps);
+            j++;
         }
+        mask.save_ivector_value();
+        mask.save_ivector_position();
+        slope.save_dvector_value();
+        slope.save_dvector_position();
+        gpen.save_dvector_value();
+        gpen.save_dvector_position();
+    }
+    save_double_value((double)k);
+    save_identifier_string("CSpf2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_posfun);
+    return vp;
+}
+
+dvar_vector posfun(const dvar_vector& x, const double& eps, dvariable& pen)
+  {
+    CSTAR_SCOPE_N("posfun", x);
+    dvar_vector xp(x.indexmin(),x.indexmax());
+    pen += posfun_kernel(x, eps, xp);
+    return(xp);
+  }
+
+// Column bounds of every row of x, so that results for ragged matrices keep their shape
+template <class M>
+static void posfun_row_bounds(const M& x, ivector& lb, ivector& ub)
+{
+    lb.allocate(x.rowmin(),x.rowmax());
+    ub.allocate(x.rowmin(),x.rowmax());
+    for(int i = x.rowmin(); i <= x.rowmax(); i++)
+    {
+        lb(i) = x(i).indexmin();
+        ub(i) = x(i).indexmax();
+    }
+}
+
+dvar_matrix posfun(const dvar_matrix& x, const double& eps, dvariable& pen)
+  {
+    CSTAR_SCOPE_N("posfun", x);
+    ivector lb, ub;
+    posfun_row_bounds(x, lb, ub);
+    dvar_matrix xp(x.rowmin(),x.rowmax(),lb,ub);
+    dvariable p = 0.;
+    for(int i = x.rowmin(); i <= x.rowmax(); i++)
+    {
+        p += posfun_kernel(x(i), eps, xp(i));
+    }
+    pen += p;
+    return(xp);
+  }
+
+// Double versions for projections: both branches are evaluated and the result
+// selected, so the loop has no data-dependent branch and vectorizes.
+
+dvector posfun(const dvector& x, const double& eps, double& pen)
+  {
+    CSTAR_SCOPE_N("posfun", x);
+    dvector xp(x.indexmin(),x.indexmax());
+    double p = 0.;
+    for(int i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        double xi   = x(i);
+        bool below  = xi < eps;
+        double alt  = eps/(2.-(below ? xi : eps)/eps);
+        double d    = below ? xi-eps : 0.;
+        xp(i)       = below ? alt : xi;
+        p          += 0.01*d*d;
+    }
+    pen += p;
+    return(xp);
+  }
+
+dmatrix posfun(const dmatrix& x, const double& eps, double& pen)
+  {
+    CSTAR_SCOPE_N("posfun", x);
+    ivector lb, ub;
+    posfun_row_bounds(x, lb, ub);
+    dmatrix xp(x.rowmin(),x.rowmax(),lb,ub);
+    for(int i = x.rowmin(); i <= x.rowmax(); i++)
+    {
+        xp(i) = posfun(x(i), eps, pen);
     }
     return(xp);
   }
 
 // ------------------------------------------------------------------------------------ //
 // match(): Return a vector of postitions of first matches of given value x, in a table.
+// Unmatched values get table.indexmin()-1; build a MatchIndex to look up the same table repeatedly.
 
 ivector match(const ivector& x, const ivector& table)
   {
-    int i,j;
-    ivector pos(x.indexmin(),x.indexmax());
-    for(i=x.indexmin();i<=x.indexmax();i++)
-    {
-        for(j=table.indexmin();j<=table.indexmax();j++)
-        {
-            if(x(i) == table(j) )
-            {
-                pos(i) = j;
-                break;
-            }
-        }
-    }
-    return(pos);
+    CSTAR_SCOPE_N("match", x);
+    return MatchIndex(table).Match(x);
   }
 
 // =========================================================================================================
@@ -0,0 +1,157 @@
+/**
+*
+* \file lognormalize.cpp
+* \brief Normalization of log selectivity curves
+* \ingroup CSTAR
+*
+*  Shift a log selectivity curve so that the selectivity has a mean of one
+*  (a log-sum-exp about the largest element, which cannot overflow or
+*  underflow), a maximum of one, or one at the last element. One pass for
+*  the shift, one for the output, and a single derivative record for
+*  dvar_vectors.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+// =========================================================================================================
+
+/*
+ * The amount subtracted from every element of y: log(mean(exp(y))) for
+ * kMeanOne, max(y) for kMaxOne and the last element for kLastOne. imax is
+ * the index of the element the shift pins to zero (the largest, or the last).
+ */
+static double lognormalize_shift(const dvector& y, int type, int& imax)
+{
+    int i;
+    int i1 = y.indexmin();
+    int i2 = y.indexmax();
+    if(type == cstar::kLastOne)
+    {
+        imax = i2;
+        return y(i2);
+    }
+    imax = i1;
+    for(i = i1 + 1; i <= i2; i++)
+    {
+        if(y(i) > y(imax)) imax = i;
+    }
+    double m = y(imax);
+    if(type == cstar::kMaxOne) return m;
+
+    double s = 0;
+    for(i = i1; i <= i2; i++)
+    {
+        s += exp(y(i) - m);
+    }
+    return m + log(s / (i2 - i1 + 1));
+}
+
+
+// out = y less the shift; returns the index of the element pinned to zero
+static int lognormalize_apply(const dvector& y, dvector& out, int type)
+{
+    int imax;
+    double c = lognormalize_shift(y, type, imax);
+    for(int i = y.indexmin(); i <= y.indexmax(); i++)
+    {
+        out(i) = y(i) - c;
+    }
+    return imax;
+}
+
+
+namespace cstar {
+
+void lognormalize(const dvector& y, dvector& out, int type)
+{
+    CSTAR_SCOPE_N("lognormalize", y);
+    if(y.indexmax() < y.indexmin()) return;
+    lognormalize_apply(y, out, type);
+}
+
+
+dvector lognormalize(const dvector& y, int type)
+{
+    CSTAR_SCOPE_N("lognormalize", y);
+    dvector out(y.indexmin(),y.indexmax());
+    lognormalize(y, out, type);
+    return out;
+}
+
+
+/*
+ * Adjoint of lognormalize(). With out = y - c and S = sum(dfout):
+ *   kMeanOne: dfy = dfout - w S, w = exp(out)/n the softmax weights,
+ *   kMaxOne, kLastOne: dfy = dfout, less S at the element pinned to zero.
+ */
+static void df_lognormalize(void)
+{
+    verify_identifier_string("CSln2");
+    int imax                   = restore_int_value();
+    int type                   = restore_int_value();
+    dvector_position opos      = restore_dvector_position();
+    dvector out                = restore_dvector_value(opos);
+    dvar_vector_position vpos  = restore_dvar_vector_position();
+    dvector dfout              = restore_dvar_vector_derivatives(vpos);
+    dvar_vector_position ypos  = restore_dvar_vector_position();
+    verify_identifier_string("CSln1");
+
+    int i;
+    int i1 = out.indexmin();
+    int i2 = out.indexmax();
+    double S = 0;
+    for(i = i1; i <= i2; i++)
+    {
+        S += dfout(i);
+    }
+
+    dvector dfy(i1,i2);
+    if(type != kMeanOne)
+    {
+        dfy = dfout;
+        dfy(imax) -= S;
+    }
+    else
+    {
+        double n = i2 - i1 + 1;
+        for(i = i1; i <= i2; i++)
+        {
+            dfy(i) = dfout(i) - exp(out(i)) / n * S;
+        }
+    }
+    dfy.save_dvector_derivatives(ypos);
+}/* df_lognormalize() */
+
+
+dvar_vector lognormalize(const dvar_vector& y, int type)
+{
+    CSTAR_SCOPE_N("lognormalize", y);
+    dvector yv = value(y);
+    dvector out(yv.indexmin(),yv.indexmax());
+    if(out.indexmax() < out.indexmin()) return nograd_assign(out);
+    int imax = lognormalize_apply(yv, out, type);
+    dvar_vector vout = nograd_assign(out);
+
+    save_identifier_string("CSln1");
+    y.save_dvar_vector_position();
+    vout.save_dvar_vector_position();
+    out.save_dvector_value();
+    out.save_dvector_position();
+    save_int_value(type);
+    save_int_value(imax);
+    save_identifier_string("CSln2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_lognormalize);
+    return vout;
+}
+
+
+void lognormalize(const dvar_vector& y, dvar_vector& out, int type)
+{
+    CSTAR_SCOPE_N("lognormalize", y);
+    out = lognormalize(y, type);
+}
+
+} // namespace cstar
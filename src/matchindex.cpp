@@ -0,0 +1,129 @@
+/**
+*
+* \file matchindex.cpp
+* \brief Reusable lookup index for match()
+* \ingroup CSTAR
+*
+*  Built once from a table of integer codes, a MatchIndex answers each
+*  query in O(1): through a direct map when the codes span a range not much
+*  larger than the table (years, size codes), otherwise through an
+*  open-addressing hash table with linear probing. Only the first
+*  occurrence of a repeated code is kept, as match() returns first matches.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+// =========================================================================================================
+
+// Multiplicative (Fibonacci) hash of a code onto 32 - shift bits
+static inline int match_hash(int x, unsigned shift)
+{
+    return (int)(((unsigned)x * 2654435769u) >> shift);
+}
+
+MatchIndex::MatchIndex(const ivector& table)
+{
+    Set_table(table);
+}
+
+void MatchIndex::Set_table(const ivector& table)
+{
+    int lb = table.indexmin();
+    int ub = table.indexmax();
+    m_lb   = lb;
+    m_n    = ub - lb + 1;
+    m_slot.deallocate();
+    m_key.deallocate();
+    if(m_n <= 0)
+    {
+        m_n     = 0;
+        m_dense = true;
+        m_min   = 0;
+        m_shift = 32;
+        return;
+    }
+
+    int lo = table(lb);
+    int hi = table(lb);
+    for(int j = lb; j <= ub; j++)
+    {
+        if(table(j) < lo) lo = table(j);
+        if(table(j) > hi) hi = table(j);
+    }
+
+    // Direct map when it costs no more than a few slots per entry
+    long long range = (long long)hi - lo + 1;
+    m_dense = range <= 4LL * m_n + 64;
+    if(m_dense)
+    {
+        m_min = lo;
+        m_slot.allocate(0,(int)range-1);
+        m_slot = NoMatch();
+        for(int j = ub; j >= lb; j--)
+        {
+            m_slot(table(j)-lo) = j;
+        }
+        return;
+    }
+
+    // Hash table at most half full
+    unsigned bits = 1;
+    while((1LL << bits) < 2LL * m_n) bits++;
+    int nslot = 1 << bits;
+    m_shift   = 32 - bits;
+    m_slot.allocate(0,nslot-1);
+    m_key.allocate(0,nslot-1);
+    m_slot = NoMatch();
+    m_key  = 0;
+    for(int j = lb; j <= ub; j++)
+    {
+        int x = table(j);
+        int h = match_hash(x, m_shift);
+        while(m_slot(h) != NoMatch() && m_key(h) != x) h = (h + 1) & (nslot - 1);
+        if(m_slot(h) == NoMatch())
+        {
+            m_slot(h) = j;
+            m_key(h)  = x;
+        }
+    }
+}
+
+int MatchIndex::Find(int x) const
+{
+    if(m_n == 0) return NoMatch();
+    if(m_dense)
+    {
+        long long k = (long long)x - m_min;
+        if(k < 0 || k > m_slot.indexmax()) return NoMatch();
+        return m_slot((int)k);
+    }
+    int mask = m_slot.indexmax();
+    int h    = match_hash(x, m_shift);
+    while(m_slot(h) != NoMatch())
+    {
+        if(m_key(h) == x) return m_slot(h);
+        h = (h + 1) & mask;
+    }
+    return NoMatch();
+}
+
+void MatchIndex::Match(const ivector& x, ivector& pos) const
+{
+    CSTAR_SCOPE_N("MatchIndex::Match", x);
+    for(int i = x.indexmin(); i <= x.indexmax(); i++)
+    {
+        pos(i) = Find(x(i));
+    }
+}
+
+ivector MatchIndex::Match(const ivector& x) const
+{
+    ivector pos(x.indexmin(),x.indexmax());
+    Match(x, pos);
+    return pos;
+}
+
+// =========================================================================================================
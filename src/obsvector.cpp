@@ -0,0 +1,50 @@
+/**
+*
+* \file obsvector.cpp
+* \brief Observation vectors with precomputed data-only terms
+* \ingroup CSTAR
+*
+*  An ObsVector holds a vector of observed numbers together with the
+*  data-only quantities that the density and diagnostic functions would
+*  otherwise recompute on every function evaluation.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+// =========================================================================================================
+
+ObsVector::ObsVector(const dvector& obs, const double& cap)
+{
+    Set_obs(obs, cap);
+}
+
+void ObsVector::Set_obs(const dvector& obs, const double& cap)
+{
+    int lb = obs.indexmin();
+    int ub = obs.indexmax();
+
+    m_obs.deallocate();
+    m_obs.allocate(lb,ub);
+    m_prop.deallocate();
+    m_prop.allocate(lb,ub);
+
+    m_sum    = 0.;
+    for(int i = lb; i <= ub; i++)
+    {
+        m_obs(i)  = obs(i);
+        m_sum    += obs(i);
+    }
+    m_lnfact = dpois_lnfact(obs);
+    for(int i = lb; i <= ub; i++)
+    {
+        m_prop(i) = (m_sum > 0.) ? obs(i)/m_sum : 0.;
+    }
+
+    m_cap     = cap;
+    m_nsample = (cap > 0.) ? min(m_sum,cap) : m_sum;
+}
+
+// =========================================================================================================
@@ -0,0 +1,273 @@
+/**
+*
+* \file parallel.cpp
+* \brief Thread pool and deterministic parallel reduction for double computations
+* \ingroup CSTAR
+*
+*  A small work-stealing pool: each thread owns a queue of index ranges,
+*  takes work from its front and steals from the back of the other queues
+*  when it runs dry. Reductions store one result per component and sum them
+*  pairwise afterwards, so totals do not depend on the number of threads.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cstar {
+
+// =========================================================================================================
+
+namespace {
+
+// True on pool threads, and on the calling thread while it works on a loop
+thread_local bool t_in_pool = false;
+
+// One ParallelFor() call: the loop body, the indices still to run, and the first exception
+struct Job
+{
+    const std::function<void(int)> *f;
+    std::atomic<int> remaining;
+    std::exception_ptr error;
+};
+
+// A range [begin,end) of one job
+struct Chunk
+{
+    int  begin;
+    int  end;
+    Job *job;
+};
+
+struct WorkQueue
+{
+    std::mutex m;
+    std::deque<Chunk> q;
+};
+
+} // namespace
+
+
+struct ThreadPool::Impl
+{
+    int nthreads;
+    std::vector<std::thread> workers;
+    std::vector<WorkQueue*>  queues;   // queues[0] belongs to the calling thread
+
+    std::mutex m;                      // guards stop, generation and Job::error
+    std::condition_variable wake;      // new work was dealt, or the pool is stopping
+    std::condition_variable done;      // a job ran its last index
+    bool stop;
+    unsigned long generation;
+    std::mutex run;                    // one ParallelFor() at a time
+
+    bool Take(int self, Chunk &c);
+    void Work(int self);
+    void Loop(int self);
+};
+
+
+/*
+ * Next chunk for thread self: the front of its own queue, otherwise the back
+ * of the first other queue that still has work.
+ */
+bool ThreadPool::Impl::Take(int self, Chunk &c)
+{
+    for(int k = 0; k < nthreads; k++)
+    {
+        int i = (self + k) % nthreads;
+        WorkQueue &w = *queues[i];
+        std::lock_guard<std::mutex> lock(w.m);
+        if(w.q.empty()) continue;
+        if(k == 0)
+        {
+            c = w.q.front();
+            w.q.pop_front();
+        }
+        else
+        {
+            c = w.q.back();
+            w.q.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+
+/*
+ * Run chunks until every queue is empty. A chunk never touches its job after
+ * the last index is counted off, since the caller may then return.
+ */
+void ThreadPool::Impl::Work(int self)
+{
+    Chunk c;
+    while(Take(self, c))
+    {
+        try
+        {
+            for(int i = c.begin; i < c.end; i++)
+            {
+                (*c.job->f)(i);
+            }
+        }
+        catch(...)
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if(!c.job->error) c.job->error = std::current_exception();
+        }
+        int count = c.end - c.begin;
+        if(c.job->remaining.fetch_sub(count) == count)
+        {
+            std::lock_guard<std::mutex> lock(m);
+            done.notify_all();
+        }
+    }
+}
+
+
+void ThreadPool::Impl::Loop(int self)
+{
+    t_in_pool = true;
+    unsigned long seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m);
+            while(!stop && generation == seen) wake.wait(lock);
+            if(stop) return;
+            seen = generation;
+        }
+        Work(self);
+    }
+}
+
+
+// =========================================================================================================
+// ThreadPool
+// =========================================================================================================
+
+ThreadPool::ThreadPool(int nthreads)
+{
+    m_impl = new Impl;
+    if(nthreads <= 0) nthreads = (int)std::thread::hardware_concurrency();
+    if(nthreads <= 0) nthreads = 1;
+    m_impl->nthreads   = nthreads;
+    m_impl->stop       = false;
+    m_impl->generation = 0;
+    for(int i = 0; i < nthreads; i++)
+    {
+        m_impl->queues.push_back(new WorkQueue);
+    }
+    for(int i = 1; i < nthreads; i++)
+    {
+        m_impl->workers.push_back(std::thread(&Impl::Loop, m_impl, i));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m);
+        m_impl->stop = true;
+    }
+    m_impl->wake.notify_all();
+    for(size_t i = 0; i < m_impl->workers.size(); i++)
+    {
+        m_impl->workers[i].join();
+    }
+    for(size_t i = 0; i < m_impl->queues.size(); i++)
+    {
+        delete m_impl->queues[i];
+    }
+    delete m_impl;
+}
+
+
+int ThreadPool::Size() const
+{
+    return m_impl->nthreads;
+}
+
+
+void ThreadPool::ParallelFor(int n, const std::function<void(int)> &f)
+{
+    if(n <= 0) return;
+    int nthreads = m_impl->nthreads;
+    if(nthreads == 1 || t_in_pool)
+    {
+        for(int i = 0; i < n; i++) f(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> running(m_impl->run);
+    Job job;
+    job.f = &f;
+    job.remaining.store(n);
+
+    // A few chunks per thread, so that stealing can even out unequal components
+    int nchunks = n < 4*nthreads ? n : 4*nthreads;
+    for(int k = 0; k < nchunks; k++)
+    {
+        Chunk c;
+        c.begin = (int)((long long)n * k / nchunks);
+        c.end   = (int)((long long)n * (k+1) / nchunks);
+        c.job   = &job;
+        WorkQueue &w = *m_impl->queues[k % nthreads];
+        std::lock_guard<std::mutex> lock(w.m);
+        w.q.push_back(c);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_impl->m);
+        m_impl->generation++;
+    }
+    m_impl->wake.notify_all();
+
+    t_in_pool = true;
+    m_impl->Work(0);
+    t_in_pool = false;
+
+    {
+        std::unique_lock<std::mutex> lock(m_impl->m);
+        while(job.remaining.load() != 0) m_impl->done.wait(lock);
+    }
+    if(job.error) std::rethrow_exception(job.error);
+}
+
+
+// =========================================================================================================
+// Deterministic reductions
+// =========================================================================================================
+
+double pairwise_sum(const double *x, int n)
+{
+    if(n <= 8)
+    {
+        double s = 0.;
+        for(int i = 0; i < n; i++) s += x[i];
+        return s;
+    }
+    int h = n / 2;
+    return pairwise_sum(x, h) + pairwise_sum(x + h, n - h);
+}
+
+
+double parallel_sum(ThreadPool &pool, int n, const std::function<double(int)> &f)
+{
+    if(n <= 0) return 0.;
+    std::vector<double> r(n);
+    pool.ParallelFor(n, [&](int i) { r[i] = f(i); });
+    return pairwise_sum(&r[0], n);
+}
+
+} // namespace cstar
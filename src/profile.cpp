@@ -0,0 +1,300 @@
+/**
+*
+* \file profile.cpp
+* \brief Call counts, cycles and input lengths per Cstar routine (-DCSTAR_PROFILE)
+* \ingroup CSTAR
+*
+*  Each thread keeps its own table of per-routine totals and its own list of
+*  trace events, so recording a call takes no lock. At exit the tables are
+*  merged into a flat text summary and the events are written as a Chrome
+*  trace (load it in chrome://tracing or https://ui.perfetto.dev).
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#ifdef CSTAR_PROFILE
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cstar {
+
+thread_local ProfileScope *t_profile_top = 0;
+
+// =========================================================================================================
+
+namespace {
+
+// Input lengths are binned by powers of two: 0, 1, 2-3, 4-7, ...
+const int  kLengthBins = 32;
+
+// Trace events kept per thread; later calls are still counted in the summary
+const long kMaxEvents  = 1L << 20;
+
+struct ProfileStats
+{
+    long long calls;
+    unsigned long long total;
+    unsigned long long self;
+    unsigned long long max;
+    long long lengths[kLengthBins];
+};
+
+struct ProfileEvent
+{
+    int  id;
+    long n;
+    unsigned long long start;
+    unsigned long long dur;
+};
+
+struct ProfileThread
+{
+    int tid;
+    std::vector<ProfileStats> stats;    // indexed by call site id
+    std::vector<ProfileEvent> events;
+    long long dropped;
+};
+
+// Buffers are never freed, so threads that have finished still appear in the report
+std::mutex                   g_profile_mutex;
+std::vector<const char*>    *g_profile_sites   = 0;
+std::vector<ProfileThread*> *g_profile_threads = 0;
+
+// Tick and clock readings at the first registration, to put the trace in microseconds
+unsigned long long g_profile_tick0 = 0;
+std::chrono::steady_clock::time_point g_profile_clock0;
+
+thread_local ProfileThread *t_profile_thread = 0;
+
+ProfileThread& profile_thread()
+{
+    if(!t_profile_thread)
+    {
+        ProfileThread *t = new ProfileThread;
+        t->dropped = 0;
+        t->events.reserve(4096);
+        std::lock_guard<std::mutex> lock(g_profile_mutex);
+        t->tid = (int)g_profile_threads->size();
+        g_profile_threads->push_back(t);
+        t_profile_thread = t;
+    }
+    return *t_profile_thread;
+}
+
+int length_bin(long n)
+{
+    int b = 0;
+    while(n > 0 && b < kLengthBins-1)
+    {
+        n >>= 1;
+        b++;
+    }
+    return b;
+}
+
+std::string length_label(int b)
+{
+    char buf[64];
+    if(b <= 1) std::snprintf(buf, sizeof(buf), "%d", b);
+    else       std::snprintf(buf, sizeof(buf), "%ld-%ld", 1L << (b-1), (1L << b) - 1);
+    return buf;
+}
+
+void json_string(std::FILE *f, const char *s)
+{
+    std::fputc('"', f);
+    for(; *s; s++)
+    {
+        if(*s == '"' || *s == '\\') std::fputc('\\', f);
+        std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+void profile_at_exit()
+{
+    std::string prefix = "cstar_profile";
+    const char *env = std::getenv("CSTAR_PROFILE_OUT");
+    if(env && *env) prefix = env;
+    ProfileReport((prefix + ".json").c_str(), (prefix + ".txt").c_str());
+}
+
+struct SummaryRow
+{
+    std::string name;
+    ProfileStats s;
+};
+
+bool by_self(const SummaryRow &a, const SummaryRow &b)
+{
+    return a.s.self > b.s.self;
+}
+
+} // namespace
+
+
+int ProfileRegister(const char *name)
+{
+    std::lock_guard<std::mutex> lock(g_profile_mutex);
+    if(!g_profile_sites)
+    {
+        g_profile_sites   = new std::vector<const char*>;
+        g_profile_threads = new std::vector<ProfileThread*>;
+        g_profile_tick0   = profile_ticks();
+        g_profile_clock0  = std::chrono::steady_clock::now();
+        std::atexit(profile_at_exit);
+    }
+    g_profile_sites->push_back(name);
+    return (int)g_profile_sites->size() - 1;
+}
+
+
+void ProfileScope::Record(unsigned long long stop)
+{
+    unsigned long long dur = stop - m_start;
+    t_profile_top = m_parent;
+    if(m_parent) m_parent->m_child += dur;
+
+    ProfileThread &t = profile_thread();
+    if((int)t.stats.size() <= m_id)
+    {
+        ProfileStats zero = ProfileStats();
+        t.stats.resize(m_id + 1, zero);
+    }
+    ProfileStats &s = t.stats[m_id];
+    s.calls++;
+    s.total += dur;
+    s.self  += dur > m_child ? dur - m_child : 0;
+    if(dur > s.max) s.max = dur;
+    if(m_n >= 0) s.lengths[length_bin(m_n)]++;
+
+    if((long)t.events.size() < kMaxEvents)
+    {
+        ProfileEvent e = {m_id, m_n, m_start, dur};
+        t.events.push_back(e);
+    }
+    else
+    {
+        t.dropped++;
+    }
+}
+
+
+// =========================================================================================================
+
+void ProfileReport(const char *trace_file, const char *summary_file)
+{
+    std::lock_guard<std::mutex> lock(g_profile_mutex);
+    if(!g_profile_sites) return;
+    const std::vector<const char*>    &sites   = *g_profile_sites;
+    const std::vector<ProfileThread*> &threads = *g_profile_threads;
+
+    // Ticks per microsecond, from the time elapsed since the first registration
+    unsigned long long tick1 = profile_ticks();
+    double us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - g_profile_clock0).count();
+    double per_us = us > 0. ? (double)(tick1 - g_profile_tick0) / us : 1.;
+    if(per_us <= 0.) per_us = 1.;
+
+    // Call sites with the same name (overloads, template instances) share a row
+    std::map<std::string,ProfileStats> merged;
+    long long dropped = 0;
+    for(size_t k = 0; k < threads.size(); k++)
+    {
+        const ProfileThread &t = *threads[k];
+        dropped += t.dropped;
+        for(size_t id = 0; id < t.stats.size(); id++)
+        {
+            const ProfileStats &s = t.stats[id];
+            if(s.calls == 0) continue;
+            std::map<std::string,ProfileStats>::iterator it = merged.find(sites[id]);
+            if(it == merged.end())
+            {
+                merged[sites[id]] = s;
+                continue;
+            }
+            ProfileStats &m = it->second;
+            m.calls += s.calls;
+            m.total += s.total;
+            m.self  += s.self;
+            m.max    = std::max(m.max, s.max);
+            for(int b = 0; b < kLengthBins; b++) m.lengths[b] += s.lengths[b];
+        }
+    }
+
+    std::FILE *f = std::fopen(trace_file, "w");
+    if(f)
+    {
+        std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+        for(size_t k = 0; k < threads.size(); k++)
+        {
+            const ProfileThread &t = *threads[k];
+            for(size_t i = 0; i < t.events.size(); i++)
+            {
+                const ProfileEvent &e = t.events[i];
+                double ts = (double)(long long)(e.start - g_profile_tick0) / per_us;
+                std::fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+                json_string(f, sites[e.id]);
+                std::fprintf(f, ",\"cat\":\"cstar\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                             "\"ts\":%.3f,\"dur\":%.3f", t.tid, ts, (double)e.dur / per_us);
+                if(e.n >= 0) std::fprintf(f, ",\"args\":{\"n\":%ld}", e.n);
+                std::fprintf(f, "}");
+                first = false;
+            }
+        }
+        std::fprintf(f, "\n]}\n");
+        std::fclose(f);
+    }
+
+    f = std::fopen(summary_file, "w");
+    if(!f) return;
+    std::vector<SummaryRow> rows;
+    for(std::map<std::string,ProfileStats>::const_iterator it = merged.begin(); it != merged.end(); ++it)
+    {
+        SummaryRow r = {it->first, it->second};
+        rows.push_back(r);
+    }
+    std::sort(rows.begin(), rows.end(), by_self);
+
+    unsigned long long all = 0;
+    for(size_t i = 0; i < rows.size(); i++) all += rows[i].s.self;
+
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit = "cycles";
+#else
+    const char *unit = "ns";
+#endif
+    std::fprintf(f, "Cstar profile: %zu threads, %.0f %s per microsecond\n", threads.size(), per_us, unit);
+    if(dropped > 0) std::fprintf(f, "%lld calls not in the trace (more than %ld per thread)\n", dropped, kMaxEvents);
+    std::fprintf(f, "Times are in %s; self excludes instrumented routines called from inside.\n\n", unit);
+    std::fprintf(f, "%-28s %12s %16s %16s %7s %12s %12s  %s\n",
+                 "routine", "calls", "total", "self", "self%", "mean", "max", "input lengths (bin:calls)");
+    for(size_t i = 0; i < rows.size(); i++)
+    {
+        const ProfileStats &s = rows[i].s;
+        std::fprintf(f, "%-28s %12lld %16llu %16llu %6.1f%% %12.0f %12llu ",
+                     rows[i].name.c_str(), s.calls, s.total, s.self,
+                     all > 0 ? 100. * (double)s.self / (double)all : 0.,
+                     (double)s.total / (double)s.calls, s.max);
+        for(int b = 0; b < kLengthBins; b++)
+        {
+            if(s.lengths[b] > 0) std::fprintf(f, " %s:%lld", length_label(b).c_str(), s.lengths[b]);
+        }
+        std::fprintf(f, "\n");
+    }
+    std::fclose(f);
+}
+
+} // namespace cstar
+
+#endif /* CSTAR_PROFILE */
@@ -18,12 +18,14 @@
 
 dvar_vector Selex::logistic( const dvector& x, const dvariable& mu, const dvariable& sd )
 {
-    return 1./(1.+mfexp(-(x-mu)/sd) );
+    CSTAR_SCOPE_N("Selex::logistic", x);
+    return cstar::plogis(x,mu,sd);
 }
 
 dvector Selex::logistic( const dvector& x, const double& mu, const double& sd )
 {
-    return 1./(1.+mfexp(-(x-mu)/sd) );
+    CSTAR_SCOPE_N("Selex::logistic", x);
+    return cstar::plogis<dvector>(x,mu,sd);
 }
 
 // =========================================================================================================
@@ -33,6 +35,7 @@ dvector Selex::logistic( const dvector& x, const double& mu, const double& sd )
 dvar_vector Selex::eplogis(const dvar_vector& x, const dvariable& x1, 
                             const dvariable& x2, const dvariable& gamma)
 {
+    CSTAR_SCOPE_N("Selex::eplogis", x);
     //exponential logistic based on Grant Thompson (1994) Paper, CJFAS.
     /*
     A modified version of the exponential logistic presented in Thompson's 1994 paper in CJFAS
@@ -42,25 +45,14 @@ dvar_vector Selex::eplogis(const dvar_vector& x, const dvariable& x1,
     parameter where gamma=0 is logistic, and gamma <1.0 dome=shaped and gamma==1 is undefined.
     
     */
-    RETURN_ARRAYS_INCREMENT();
-    dvariable k1,k2,alpha,beta;
-    dvariable t1 = 2.-4.*gamma+2.*gamma*gamma;
-    dvariable t3 = 1.+2.*gamma-2*gamma*gamma;
-    dvariable t5 = sqrt(1. + 4.*gamma - 4.*gamma*gamma);
-    
-    k1    = log(t1/(t3+t5));
-    k2    = log(t1/(t3-t5));
-    beta  = (k1*x2-x1*k2)/(k1-k2);
-    alpha = k2/(x2-beta);
-    dvar_vector sx = (1./(1.-gamma))*pow((1.-gamma)/gamma,gamma)*elem_div(exp(alpha*gamma*(beta-x)),1.+exp(alpha*(beta-x)));
-    
-    RETURN_ARRAYS_DECREMENT();
-    return sx;
+    // Single derivative record with the closed-form partials (see cstar::eplogis)
+    return cstar::eplogis(x,x1,x2,gamma);
 }
 
 dvector Selex::eplogis(const dvector& x, const double& x1, 
                         const double& x2, const double& gamma)
 {
+    CSTAR_SCOPE_N("Selex::eplogis", x);
     //exponential logistic based on Grant Thompson (1994) Paper, CJFAS.
     /*
     A modified version of the exponential logistic presented in Thompson's 1994 paper in CJFAS
@@ -70,16 +62,9 @@ dvector Selex::eplogis(const dvector& x, const double& x1,
     parameter where gamma=0 is logistic, and gamma <1.0 dome=shaped and gamma==1 is undefined.
     
     */
-    double k1,k2,alpha,beta;
-    double t1 = 2.-4.*gamma+2.*gamma*gamma;
-    double t3 = 1.+2.*gamma-2*gamma*gamma;
-    double t5 = sqrt(1. + 4.*gamma - 4.*gamma*gamma);
-    
-    k1    = log(t1/(t3+t5));
-    k2    = log(t1/(t3-t5));
-    beta  = (k1*x2-x1*k2)/(k1-k2);
-    alpha = k2/(x2-beta);
-    dvector sx = (1./(1.-gamma))*pow((1.-gamma)/gamma,gamma)*elem_div(exp(alpha*gamma*(beta-x)),1.+exp(alpha*(beta-x)));
+    dvector sx(x.indexmin(),x.indexmax());
+    if(sx.indexmax() >= sx.indexmin())
+        cstar::veplogis(&x.elem(x.indexmin()), &sx.elem(sx.indexmin()), size_count(x), x1, x2, gamma);
     
     return sx;
 }
@@ -91,34 +76,589 @@ dvector Selex::eplogis(const dvector& x, const double& x1,
 
 dvector Selex::linapprox(const dvector& x, const dvector& y, const dvector& xout)
 {
+    CSTAR_SCOPE_N("Selex::linapprox", xout);
     // Piece-wise linear approximation for n points in xout between min(x) and max(y):
-    int i,j,k;
-    int n = xout.indexmax() - xout.indexmin() + 1;
-    double v;
-    dvector yout(xout.indexmin(),xout.indexmax());
-    
-    for(k = xout.indexmin(); k <= xout.indexmax(); k++)
-    {
-        v       = xout(k);
-        yout(k) = approx(v,x,y);
-    }
-    return yout;
+    return approx(xout,x,y);
 }
 
 dvar_vector Selex::linapprox(const dvector& x, const dvar_vector& y, const dvector& xout)
 {
+    CSTAR_SCOPE_N("Selex::linapprox", xout);
     // Piece-wise linear approximation for n points in xout between min(x) and max(y):
-    int i,j,k;
-    int n = xout.indexmax() - xout.indexmin() + 1;
-    double v;
-    dvar_vector yout(xout.indexmin(),xout.indexmax());
-    for(k = xout.indexmin(); k <= xout.indexmax(); k++)
+    return approx(xout,x,y);
+}
+
+dvector Selex::linapprox(const ApproxTable& table, const dvector& y)
+{
+    CSTAR_SCOPE_N("Selex::linapprox", y);
+    // Piece-wise linear approximation at the output points cached in table:
+    return table.Interpolate(y);
+}
+
+dvar_vector Selex::linapprox(const ApproxTable& table, const dvar_vector& y)
+{
+    CSTAR_SCOPE_N("Selex::linapprox", y);
+    // Piece-wise linear approximation at the output points cached in table:
+    return table.Interpolate(y);
+}
+
+
+// =========================================================================================================
+// Logistic kernels and their closed-form partial derivatives
+// =========================================================================================================
+
+namespace cstar {
+
+// Curves sharing the single-record adjoint df_plogis_curve()
+enum { kCurvePlogis = 0, kCurvePlogis95 = 1, kCurveLplogis = 2 };
+
+/*
+ * Logistic curve in (mean, sd) over n points, through the vectorized kernel.
+ */
+static void plogis_row(const double* x, double* y, int n, double mean, double sd)
+{
+    if(n > 0) vplogis(x, y, n, mean, sd);
+}
+
+
+/*
+ * Log of the logistic curve over n points, as -log(1+exp(-z)) or
+ * z-log(1+exp(z)), whichever exponent is not positive (see lplogis()).
+ */
+static void lplogis_row(const double* x, double* y, int n, double mean, double sd)
+{
+    for(int j = 0; j < n; j++)
+    {
+        double z = (x[j] - mean) / sd;
+        y[j] = (z >= 0) ? -log(1. + exp(-z)) : z - log(1. + exp(z));
+    }
+}
+
+
+/*
+ * Logistic95 curve over n points: a logistic with sd = (s95 - s50)/log(19),
+ * scaled to one at the last point. p receives the curve before scaling.
+ */
+static void plogis95_row(const double* x, double* y, double* p, int n, double s50, double s95)
+{
+    if(n <= 0) return;
+    vplogis(x, p, n, s50, (s95 - s50) / log(19.));
+    double pn = p[n-1];
+    for(int j = 0; j < n; j++) y[j] = p[j] / pn;
+}
+
+
+/*
+ * Partial derivatives of sum(g*y) for one logistic curve y = 1/(1+exp(-z)),
+ * z = (x-mean)/sd:
+ *   dmean = -sum(q)/sd,  dsd = -sum(q*(x-mean))/sd^2,  dx = q/sd,
+ * with q = g*y*(1-y), or q = g*(1-y) when g is the adjoint of log(y).
+ * dx is accumulated only when it is not null.
+ */
+static void plogis_row_grad(const double* x, const double* y, const double* g, int n,
+                            double mean, double sd, double& dmean, double& dsd, double* dx,
+                            bool logy = false)
+{
+    double gm = 0;
+    double gs = 0;
+    for(int j = 0; j < n; j++)
+    {
+        double q = g[j] * (1. - y[j]) * (logy ? 1. : y[j]);
+        gm += q;
+        gs += q * (x[j] - mean);
+        if(dx) dx[j] += q / sd;
+    }
+    dmean = -gm / sd;
+    dsd   = -gs / (sd * sd);
+}
+
+
+/*
+ * Partial derivatives of sum(g*out) for one logistic95 curve out = p/p_n,
+ * with p logistic in a = log(19)(x-s50)/d and d = s95-s50. The adjoint on p
+ * is g/p_n, less sum(g*p)/p_n^2 at the last point; then with q = dfp*p(1-p):
+ *   ds50 = sum(q(a - log(19)))/d,  ds95 = -sum(q a)/d,  dx = q log(19)/d.
+ */
+static void plogis95_row_grad(const double* x, const double* p, const double* g, int n,
+                              double s50, double s95, double& ds50, double& ds95, double* dx)
+{
+    ds50 = ds95 = 0;
+    if(n <= 0) return;
+    int j;
+    double c  = log(19.);
+    double d  = s95 - s50;
+    double pn = p[n-1];
+    double G  = 0;
+    for(j = 0; j < n; j++)
+    {
+        G += g[j] * p[j];
+    }
+    G /= pn * pn;
+
+    double g50 = 0;
+    double g95 = 0;
+    for(j = 0; j < n; j++)
+    {
+        double dfp = g[j] / pn;
+        if(j == n-1) dfp -= G;
+        double q = dfp * p[j] * (1. - p[j]);
+        double a = c * (x[j] - s50) / d;
+        g50 += q * (a - c);
+        g95 += q * a;
+        if(dx) dx[j] += q * c / d;
+    }
+    ds50 =  g50 / d;
+    ds95 = -g95 / d;
+}
+
+
+// =========================================================================================================
+// Analytic-gradient logistic curves: one derivative record per curve
+// =========================================================================================================
+
+/*
+ * Adjoint of the single-record logistic, logistic95 and log logistic. The
+ * curve is recomputed from the saved values; dx is only formed when x was a
+ * dvar_vector.
+ */
+static void df_plogis_curve(void)
+{
+    verify_identifier_string("CSpl2");
+    int kind                     = restore_int_value();
+    int xvar                     = restore_int_value();
+    dvector_position xpos        = restore_dvector_position();
+    dvector x                    = restore_dvector_value(xpos);
+    double b                     = restore_double_value();
+    double a                     = restore_double_value();
+    dvar_vector_position ypos    = restore_dvar_vector_position();
+    dvector dfy                  = restore_dvar_vector_derivatives(ypos);
+    prevariable_position bpos    = restore_prevariable_position();
+    prevariable_position apos    = restore_prevariable_position();
+    dvar_vector_position xvpos;
+    if(xvar) xvpos = restore_dvar_vector_position();
+    verify_identifier_string("CSpl1");
+
+    int n = size_count(x);
+    int j1 = x.indexmin();
+    dvector y(j1,x.indexmax());
+    dvector dfx(j1,x.indexmax());
+    dfx.initialize();
+    double* xp = n > 0 ? &x.elem(j1) : 0;
+    double* yp = n > 0 ? &y.elem(j1) : 0;
+    double* gp = n > 0 ? &dfy.elem(j1) : 0;
+    double* dxp = (xvar && n > 0) ? &dfx.elem(j1) : 0;
+
+    double da, db;
+    if(kind == kCurvePlogis95)
+    {
+        dvector p(j1,x.indexmax());
+        double* pp = n > 0 ? &p.elem(j1) : 0;
+        plogis95_row(xp, yp, pp, n, a, b);
+        plogis95_row_grad(xp, pp, gp, n, a, b, da, db, dxp);
+    }
+    else
+    {
+        plogis_row(xp, yp, n, a, b);
+        plogis_row_grad(xp, yp, gp, n, a, b, da, db, dxp, kind == kCurveLplogis);
+    }
+    save_double_derivative(da, apos);
+    save_double_derivative(db, bpos);
+    if(xvar) dfx.save_dvector_derivatives(xvpos);
+}/* df_plogis_curve() */
+
+
+static dvar_vector plogis_curve(const dvector& x, const dvar_vector* xvar,
+                                const prevariable& a, const prevariable& b, int kind)
+{
+    int n = size_count(x);
+    int j1 = x.indexmin();
+    double av = value(a);
+    double bv = value(b);
+    dvector y(j1,x.indexmax());
+    if(kind == kCurvePlogis95)
+    {
+        dvector p(j1,x.indexmax());
+        if(n > 0) plogis95_row(&x.elem(j1), &y.elem(j1), &p.elem(j1), n, av, bv);
+    }
+    else if(kind == kCurveLplogis)
+    {
+        if(n > 0) lplogis_row(&x.elem(j1), &y.elem(j1), n, av, bv);
+    }
+    else
+    {
+        if(n > 0) plogis_row(&x.elem(j1), &y.elem(j1), n, av, bv);
+    }
+    dvar_vector vy = nograd_assign(y);
+
+    save_identifier_string("CSpl1");
+    if(xvar) xvar->save_dvar_vector_position();
+    a.save_prevariable_position();
+    b.save_prevariable_position();
+    vy.save_dvar_vector_position();
+    save_double_value(av);
+    save_double_value(bv);
+    x.save_dvector_value();
+    x.save_dvector_position();
+    save_int_value(xvar != 0);
+    save_int_value(kind);
+    save_identifier_string("CSpl2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_plogis_curve);
+    return vy;
+}
+
+
+dvar_vector plogis(const dvector& x, const dvariable& mean, const dvariable& sd)
+{
+    CSTAR_SCOPE_N("plogis", x);
+    return plogis_curve(x, 0, mean, sd, kCurvePlogis);
+}
+
+dvar_vector plogis(const dvar_vector& x, const dvariable& mean, const dvariable& sd)
+{
+    CSTAR_SCOPE_N("plogis", x);
+    return plogis_curve(value(x), &x, mean, sd, kCurvePlogis);
+}
+
+void plogis(const dvector& x, const dvariable& mean, const dvariable& sd, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("plogis", x);
+    out = plogis_curve(x, 0, mean, sd, kCurvePlogis);
+}
+
+void plogis(const dvar_vector& x, const dvariable& mean, const dvariable& sd, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("plogis", x);
+    out = plogis_curve(value(x), &x, mean, sd, kCurvePlogis);
+}
+
+dvar_vector plogis95(const dvector& x, const dvariable& s50, const dvariable& s95)
+{
+    CSTAR_SCOPE_N("plogis95", x);
+    return plogis_curve(x, 0, s50, s95, kCurvePlogis95);
+}
+
+dvar_vector plogis95(const dvar_vector& x, const dvariable& s50, const dvariable& s95)
+{
+    CSTAR_SCOPE_N("plogis95", x);
+    return plogis_curve(value(x), &x, s50, s95, kCurvePlogis95);
+}
+
+void plogis95(const dvector& x, const dvariable& s50, const dvariable& s95, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("plogis95", x);
+    out = plogis_curve(x, 0, s50, s95, kCurvePlogis95);
+}
+
+void plogis95(const dvar_vector& x, const dvariable& s50, const dvariable& s95, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("plogis95", x);
+    out = plogis_curve(value(x), &x, s50, s95, kCurvePlogis95);
+}
+
+void lplogis(const dvector& x, const dvariable& mean, const dvariable& sd, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("lplogis", x);
+    out = plogis_curve(x, 0, mean, sd, kCurveLplogis);
+}
+
+void lplogis(const dvar_vector& x, const dvariable& mean, const dvariable& sd, dvar_vector& out)
+{
+    CSTAR_SCOPE_N("lplogis", x);
+    out = plogis_curve(value(x), &x, mean, sd, kCurveLplogis);
+}
+
+
+/*
+ * Adjoint of the single-record exponential logistic. With u = beta - x,
+ * sigma = 1/(1+exp(-alpha u)) and w = g*sx, log(sx) has partials
+ *   alpha: gamma u - u sigma,  u: alpha(gamma - sigma),
+ *   gamma (direct): log((1-gamma)/gamma) + alpha u,
+ * which are chained back through alpha = k2/(x2-beta),
+ * beta = (k1 x2 - x1 k2)/(k1-k2) and k1(gamma), k2(gamma).
+ */
+static void df_eplogis_curve(void)
+{
+    verify_identifier_string("CSep2");
+    int xvar                     = restore_int_value();
+    dvector_position xpos        = restore_dvector_position();
+    dvector x                    = restore_dvector_value(xpos);
+    double gamma                 = restore_double_value();
+    double x2                    = restore_double_value();
+    double x1                    = restore_double_value();
+    dvar_vector_position ypos    = restore_dvar_vector_position();
+    dvector dfy                  = restore_dvar_vector_derivatives(ypos);
+    prevariable_position gpos    = restore_prevariable_position();
+    prevariable_position x2pos   = restore_prevariable_position();
+    prevariable_position x1pos   = restore_prevariable_position();
+    dvar_vector_position xvpos;
+    if(xvar) xvpos = restore_dvar_vector_position();
+    verify_identifier_string("CSep1");
+
+    double t1 = 2.-4.*gamma+2.*gamma*gamma;
+    double t3 = 1.+2.*gamma-2.*gamma*gamma;
+    double t5 = sqrt(1. + 4.*gamma - 4.*gamma*gamma);
+    double k1 = log(t1/(t3+t5));
+    double k2 = log(t1/(t3-t5));
+    double beta  = (k1*x2-x1*k2)/(k1-k2);
+    double alpha = k2/(x2-beta);
+    double c0    = log(1./(1.-gamma)) + gamma*log((1.-gamma)/gamma);
+    double dc0   = log((1.-gamma)/gamma);
+
+    int j;
+    double A = 0;
+    double U = 0;
+    double G = 0;
+    dvector dfx(x.indexmin(),x.indexmax());
+    for(j = x.indexmin(); j <= x.indexmax(); j++)
     {
-        v       = xout(k);
-        yout(k) = approx(v,x,y);
+        double u     = beta - x(j);
+        double sigma = 1./(1.+exp(-alpha*u));
+        double sx    = exp(c0 + alpha*gamma*u - log(1.+exp(alpha*u)));
+        double w     = dfy(j) * sx;
+        A += w * (gamma*u - u*sigma);
+        U += w * alpha * (gamma - sigma);
+        G += w * (dc0 + alpha*u);
+        dfx(j) = -w * alpha * (gamma - sigma);
     }
-    return yout;
+
+    double d   = x2 - beta;
+    double kk  = k1 - k2;
+    double dfbeta = U + A*k2/(d*d);
+    double dfk2 = A/d + dfbeta*k1*(x2-x1)/(kk*kk);
+    double dfk1 = dfbeta*k2*(x1-x2)/(kk*kk);
+    double dfx2 = -A*k2/(d*d) + dfbeta*k1/kk;
+    double dfx1 = -dfbeta*k2/kk;
+    double dt1  = -4.+4.*gamma;
+    double dt3  = 2.-4.*gamma;
+    double dt5  = (2.-4.*gamma)/t5;
+    double dfgamma = G + dfk1*(dt1/t1 - (dt3+dt5)/(t3+t5))
+                       + dfk2*(dt1/t1 - (dt3-dt5)/(t3-t5));
+
+    save_double_derivative(dfx1, x1pos);
+    save_double_derivative(dfx2, x2pos);
+    save_double_derivative(dfgamma, gpos);
+    if(xvar) dfx.save_dvector_derivatives(xvpos);
+}/* df_eplogis_curve() */
+
+
+static dvar_vector eplogis_curve(const dvector& x, const dvar_vector* xvar, const prevariable& x1,
+                                 const prevariable& x2, const prevariable& gamma)
+{
+    double v1 = value(x1);
+    double v2 = value(x2);
+    double vg = value(gamma);
+    dvector y(x.indexmin(),x.indexmax());
+    if(y.indexmax() >= y.indexmin())
+        veplogis(&x.elem(x.indexmin()), &y.elem(y.indexmin()), size_count(x), v1, v2, vg);
+    dvar_vector vy = nograd_assign(y);
+
+    save_identifier_string("CSep1");
+    if(xvar) xvar->save_dvar_vector_position();
+    x1.save_prevariable_position();
+    x2.save_prevariable_position();
+    gamma.save_prevariable_position();
+    vy.save_dvar_vector_position();
+    save_double_value(v1);
+    save_double_value(v2);
+    save_double_value(vg);
+    x.save_dvector_value();
+    x.save_dvector_position();
+    save_int_value(xvar != 0);
+    save_identifier_string("CSep2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_eplogis_curve);
+    return vy;
+}
+
+
+dvar_vector eplogis(const dvector& x, const dvariable& x1, const dvariable& x2, const dvariable& gamma)
+{
+    CSTAR_SCOPE_N("eplogis", x);
+    return eplogis_curve(x, 0, x1, x2, gamma);
+}
+
+dvar_vector eplogis(const dvar_vector& x, const dvariable& x1, const dvariable& x2, const dvariable& gamma)
+{
+    CSTAR_SCOPE_N("eplogis", x);
+    return eplogis_curve(value(x), &x, x1, x2, gamma);
+}
+
+
+// =========================================================================================================
+// Batched logistic curves: one row per curve, parameters in struct-of-arrays form
+// =========================================================================================================
+
+/*
+ * Fill row i of y with the logistic curve for (mean(i), sd(i)), and row i
+ * of p with the unscaled logistic95 curve for (s50(i), s95(i)). Every row is
+ * one contiguous sweep of the vectorized kernel over the shared x.
+ */
+static void plogis_rows(const dvector& x, const dvector& mean, const dvector& sd, dmatrix& y)
+{
+    int n = size_count(x);
+    if(n <= 0) return;
+    for(int i = mean.indexmin(); i <= mean.indexmax(); i++)
+    {
+        plogis_row(&x.elem(x.indexmin()), &y(i).elem(x.indexmin()), n, mean(i), sd(i));
+    }
+}
+
+static void plogis95_rows(const dvector& x, const dvector& s50, const dvector& s95,
+                          dmatrix& y, dmatrix& p)
+{
+    int n = size_count(x);
+    if(n <= 0) return;
+    for(int i = s50.indexmin(); i <= s50.indexmax(); i++)
+    {
+        plogis95_row(&x.elem(x.indexmin()), &y(i).elem(x.indexmin()), &p(i).elem(x.indexmin()),
+                     n, s50(i), s95(i));
+    }
+}
+
+
+dmatrix plogis(const dvector& x, const dvector& mean, const dvector& sd)
+{
+    CSTAR_SCOPE_N("plogis (matrix)", x);
+    dmatrix y(mean.indexmin(),mean.indexmax(),x.indexmin(),x.indexmax());
+    plogis_rows(x, mean, sd, y);
+    return y;
+}
+
+
+dmatrix plogis95(const dvector& x, const dvector& s50, const dvector& s95)
+{
+    CSTAR_SCOPE_N("plogis95 (matrix)", x);
+    dmatrix y(s50.indexmin(),s50.indexmax(),x.indexmin(),x.indexmax());
+    dmatrix p(s50.indexmin(),s50.indexmax(),x.indexmin(),x.indexmax());
+    plogis95_rows(x, s50, s95, y, p);
+    return y;
+}
+
+
+/*
+ * Adjoint of the batched logistic. The curves are recomputed from the saved
+ * parameter values rather than stored, so the record holds only the vectors.
+ */
+static void df_plogis_rows(void)
+{
+    verify_identifier_string("CSpb2");
+    dvector_position sdpos   = restore_dvector_position();
+    dvector sd               = restore_dvector_value(sdpos);
+    dvector_position mpos    = restore_dvector_position();
+    dvector mean             = restore_dvector_value(mpos);
+    dvector_position xpos    = restore_dvector_position();
+    dvector x                = restore_dvector_value(xpos);
+    dvar_matrix_position ypos    = restore_dvar_matrix_position();
+    dmatrix dfy              = restore_dvar_matrix_derivatives(ypos);
+    dvar_vector_position sdvpos  = restore_dvar_vector_position();
+    dvar_vector_position mvpos   = restore_dvar_vector_position();
+    verify_identifier_string("CSpb1");
+
+    int n  = size_count(x);
+    int j1 = x.indexmin();
+    dmatrix y(mean.indexmin(),mean.indexmax(),j1,x.indexmax());
+    plogis_rows(x, mean, sd, y);
+
+    dvector dfmean(mean.indexmin(),mean.indexmax());
+    dvector dfsd(sd.indexmin(),sd.indexmax());
+    dfmean.initialize();
+    dfsd.initialize();
+    if(n > 0)
+    {
+        for(int i = mean.indexmin(); i <= mean.indexmax(); i++)
+        {
+            plogis_row_grad(&x.elem(j1), &y(i).elem(j1), &dfy(i).elem(j1), n,
+                            mean(i), sd(i), dfmean(i), dfsd(i), 0);
+        }
+    }
+    dfmean.save_dvector_derivatives(mvpos);
+    dfsd.save_dvector_derivatives(sdvpos);
+}/* df_plogis_rows() */
+
+
+dvar_matrix plogis(const dvector& x, const dvar_vector& mean, const dvar_vector& sd)
+{
+    CSTAR_SCOPE_N("plogis (matrix)", x);
+    dvector m = value(mean);
+    dvector s = value(sd);
+    dvar_matrix y = nograd_assign(plogis(x, m, s));
+    save_identifier_string("CSpb1");
+    mean.save_dvar_vector_position();
+    sd.save_dvar_vector_position();
+    y.save_dvar_matrix_position();
+    x.save_dvector_value();
+    x.save_dvector_position();
+    m.save_dvector_value();
+    m.save_dvector_position();
+    s.save_dvector_value();
+    s.save_dvector_position();
+    save_identifier_string("CSpb2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_plogis_rows);
+    return y;
+}
+
+
+/*
+ * Adjoint of the batched plogis95, row by row as for the single curve.
+ */
+static void df_plogis95_rows(void)
+{
+    verify_identifier_string("CSpc2");
+    dvector_position s95pos  = restore_dvector_position();
+    dvector s95              = restore_dvector_value(s95pos);
+    dvector_position s50pos  = restore_dvector_position();
+    dvector s50              = restore_dvector_value(s50pos);
+    dvector_position xpos    = restore_dvector_position();
+    dvector x                = restore_dvector_value(xpos);
+    dvar_matrix_position ypos    = restore_dvar_matrix_position();
+    dmatrix dfy              = restore_dvar_matrix_derivatives(ypos);
+    dvar_vector_position s95vpos = restore_dvar_vector_position();
+    dvar_vector_position s50vpos = restore_dvar_vector_position();
+    verify_identifier_string("CSpc1");
+
+    int n  = size_count(x);
+    int j1 = x.indexmin();
+    dmatrix y(s50.indexmin(),s50.indexmax(),j1,x.indexmax());
+    dmatrix p(s50.indexmin(),s50.indexmax(),j1,x.indexmax());
+    plogis95_rows(x, s50, s95, y, p);
+
+    dvector dfs50(s50.indexmin(),s50.indexmax());
+    dvector dfs95(s95.indexmin(),s95.indexmax());
+    dfs50.initialize();
+    dfs95.initialize();
+    if(n > 0)
+    {
+        for(int i = s50.indexmin(); i <= s50.indexmax(); i++)
+        {
+            plogis95_row_grad(&x.elem(j1), &p(i).elem(j1), &dfy(i).elem(j1), n,
+                              s50(i), s95(i), dfs50(i), dfs95(i), 0);
+        }
+    }
+    dfs50.save_dvector_derivatives(s50vpos);
+    dfs95.save_dvector_derivatives(s95vpos);
+}/* df_plogis95_rows() */
+
+
+dvar_matrix plogis95(const dvector& x, const dvar_vector& s50, const dvar_vector& s95)
+{
+    CSTAR_SCOPE_N("plogis95 (matrix)", x);
+    dvector m = value(s50);
+    dvector n = value(s95);
+    dvar_matrix y = nograd_assign(plogis95(x, m, n));
+    save_identifier_string("CSpc1");
+    s50.save_dvar_vector_position();
+    s95.save_dvar_vector_position();
+    y.save_dvar_matrix_position();
+    x.save_dvector_value();
+    x.save_dvector_position();
+    m.save_dvector_value();
+    m.save_dvector_position();
+    n.save_dvector_value();
+    n.save_dvector_position();
+    save_identifier_string("CSpc2");
+    gradient_structure::GRAD_STACK1->set_gradient_stack(df_plogis95_rows);
+    return y;
 }
 
+} // namespace cstar
 
 //#endif	/* SELECTIVITY_HPP */
@@ -0,0 +1,332 @@
+/**
+*
+* \file simd.cpp
+* \brief Vectorized kernels for the double-data selectivity curves
+* \ingroup CSTAR
+*
+*  Fused kernels that compute a whole logistic or exponential-logistic
+*  curve in one pass over raw arrays, with no temporaries. On x86 the
+*  AVX2/FMA or SSE2 version is chosen at run time; other targets use the
+*  scalar loop.
+*
+*  The vector exp reduces x = n*log(2) + r with |r| <= log(2)/2, evaluates
+*  a degree 12 Taylor polynomial for exp(r) and scales by 2^n through the
+*  exponent bits. Arguments are clamped to [-708, 709], so the result is
+*  always a finite, normal double; the relative error is below 1e-15.
+*
+*  This is not the clamp of ADMB's mfexp(), which the curves used before:
+*  mfexp() is exact only on [-60, 60] and continues linearly in exp(+-60)
+*  beyond it. The kernels use the exact exp() out to the clamp, so a
+*  logistic more than 60 sd below its mean now tends to zero where the
+*  mfexp() version levelled off near exp(-60)/2 (about 4e-27); elsewhere
+*  the two agree to rounding. 'cstar_bench check' compares every dispatch
+*  level with the scalar loop and with the mfexp() curves.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CSTAR_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// =========================================================================================================
+// Scalar reference kernels
+// =========================================================================================================
+
+// Clamp exp() arguments the same way as the vector lanes, so results do not depend on position.
+// A NaN argument gives NaN in both.
+#define VEXP_XMIN   -708.0
+#define VEXP_XMAX    709.0
+
+static inline double exp_clamped(double x)
+{
+    return exp(x < VEXP_XMIN ? VEXP_XMIN : (x > VEXP_XMAX ? VEXP_XMAX : x));
+}
+
+static void plogis_scalar(const double* x, double* y, int n, double mean, double sd)
+{
+    for(int i = 0; i < n; i++)
+    {
+        y[i] = 1.0/(1.0+exp_clamped(-(x[i]-mean)/sd));
+    }
+}
+
+static void eplogis_scalar(const double* x, double* y, int n,
+                           double scale, double alpha, double beta, double gamma)
+{
+    for(int i = 0; i < n; i++)
+    {
+        double t = alpha*(beta-x[i]);
+        y[i] = scale*exp_clamped(gamma*t)/(1.0+exp_clamped(t));
+    }
+}
+
+static void exp_scalar(const double* x, double* y, int n)
+{
+    for(int i = 0; i < n; i++) y[i] = exp_clamped(x[i]);
+}
+
+#ifdef CSTAR_X86_SIMD
+
+// Constants for the vector exp.
+#define VEXP_LOG2E   1.4426950408889634074
+#define VEXP_LN2_HI  6.93145751953125e-1
+#define VEXP_LN2_LO  1.42860682030941723212e-6
+#define VEXP_MAGIC   6755399441055744.0      /* 1.5*2^52: rounds to nearest and exposes the integer bits */
+
+// =========================================================================================================
+// AVX2/FMA kernels, 4 doubles per step
+// =========================================================================================================
+
+__attribute__((target("avx2,fma")))
+static inline __m256d exp_avx2(__m256d x)
+{
+    // min/max return their second operand for NaN: keep x second so a NaN passes through
+    x = _mm256_min_pd(_mm256_set1_pd(VEXP_XMAX), _mm256_max_pd(_mm256_set1_pd(VEXP_XMIN), x));
+    __m256d magic = _mm256_set1_pd(VEXP_MAGIC);
+    __m256d t = _mm256_fmadd_pd(x, _mm256_set1_pd(VEXP_LOG2E), magic);
+    __m256d n = _mm256_sub_pd(t, magic);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(VEXP_LN2_HI), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(VEXP_LN2_LO), r);
+
+    __m256d p = _mm256_set1_pd(1./479001600.);
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./39916800.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./3628800.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./362880.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./40320.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./5040.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./720.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./120.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./24.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1./6.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(0.5));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.));
+    p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(1.));
+
+    __m256i k = _mm256_sub_epi64(_mm256_castpd_si256(t), _mm256_castpd_si256(magic));
+    k = _mm256_slli_epi64(_mm256_add_epi64(k, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_mul_pd(p, _mm256_castsi256_pd(k));
+}
+
+__attribute__((target("avx2,fma")))
+static void exp_avx2(const double* x, double* y, int n)
+{
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        _mm256_storeu_pd(y + i, exp_avx2(_mm256_loadu_pd(x + i)));
+    }
+    exp_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void plogis_avx2(const double* x, double* y, int n, double mean, double sd)
+{
+    __m256d vmean = _mm256_set1_pd(mean);
+    __m256d vrsd  = _mm256_set1_pd(-1.0/sd);
+    __m256d one   = _mm256_set1_pd(1.0);
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d z = _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(x + i), vmean), vrsd);
+        _mm256_storeu_pd(y + i, _mm256_div_pd(one, _mm256_add_pd(one, exp_avx2(z))));
+    }
+    plogis_scalar(x + i, y + i, n - i, mean, sd);
+}
+
+__attribute__((target("avx2,fma")))
+static void eplogis_avx2(const double* x, double* y, int n,
+                         double scale, double alpha, double beta, double gamma)
+{
+    __m256d valpha = _mm256_set1_pd(alpha);
+    __m256d vbeta  = _mm256_set1_pd(beta);
+    __m256d vgamma = _mm256_set1_pd(gamma);
+    __m256d vscale = _mm256_set1_pd(scale);
+    __m256d one    = _mm256_set1_pd(1.0);
+    int i = 0;
+    for(; i + 4 <= n; i += 4)
+    {
+        __m256d t = _mm256_mul_pd(valpha, _mm256_sub_pd(vbeta, _mm256_loadu_pd(x + i)));
+        __m256d num = _mm256_mul_pd(vscale, exp_avx2(_mm256_mul_pd(vgamma, t)));
+        _mm256_storeu_pd(y + i, _mm256_div_pd(num, _mm256_add_pd(one, exp_avx2(t))));
+    }
+    eplogis_scalar(x + i, y + i, n - i, scale, alpha, beta, gamma);
+}
+
+// =========================================================================================================
+// SSE2 kernels, 2 doubles per step (baseline on x86-64)
+// =========================================================================================================
+
+__attribute__((target("sse2")))
+static inline __m128d exp_sse2(__m128d x)
+{
+    // min/max return their second operand for NaN: keep x second so a NaN passes through
+    x = _mm_min_pd(_mm_set1_pd(VEXP_XMAX), _mm_max_pd(_mm_set1_pd(VEXP_XMIN), x));
+    __m128d magic = _mm_set1_pd(VEXP_MAGIC);
+    __m128d t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(VEXP_LOG2E)), magic);
+    __m128d n = _mm_sub_pd(t, magic);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(VEXP_LN2_HI)));
+    r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(VEXP_LN2_LO)));
+
+    __m128d p = _mm_set1_pd(1./479001600.);
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./39916800.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./3628800.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./362880.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./40320.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./5040.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./720.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./120.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./24.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1./6.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(0.5));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.));
+    p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(1.));
+
+    __m128i k = _mm_sub_epi64(_mm_castpd_si128(t), _mm_castpd_si128(magic));
+    k = _mm_slli_epi64(_mm_add_epi64(k, _mm_set1_epi64x(1023)), 52);
+    return _mm_mul_pd(p, _mm_castsi128_pd(k));
+}
+
+__attribute__((target("sse2")))
+static void exp_sse2(const double* x, double* y, int n)
+{
+    int i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+        _mm_storeu_pd(y + i, exp_sse2(_mm_loadu_pd(x + i)));
+    }
+    exp_scalar(x + i, y + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void plogis_sse2(const double* x, double* y, int n, double mean, double sd)
+{
+    __m128d vmean = _mm_set1_pd(mean);
+    __m128d vrsd  = _mm_set1_pd(-1.0/sd);
+    __m128d one   = _mm_set1_pd(1.0);
+    int i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+        __m128d z = _mm_mul_pd(_mm_sub_pd(_mm_loadu_pd(x + i), vmean), vrsd);
+        _mm_storeu_pd(y + i, _mm_div_pd(one, _mm_add_pd(one, exp_sse2(z))));
+    }
+    plogis_scalar(x + i, y + i, n - i, mean, sd);
+}
+
+__attribute__((target("sse2")))
+static void eplogis_sse2(const double* x, double* y, int n,
+                         double scale, double alpha, double beta, double gamma)
+{
+    __m128d valpha = _mm_set1_pd(alpha);
+    __m128d vbeta  = _mm_set1_pd(beta);
+    __m128d vgamma = _mm_set1_pd(gamma);
+    __m128d vscale = _mm_set1_pd(scale);
+    __m128d one    = _mm_set1_pd(1.0);
+    int i = 0;
+    for(; i + 2 <= n; i += 2)
+    {
+        __m128d t = _mm_mul_pd(valpha, _mm_sub_pd(vbeta, _mm_loadu_pd(x + i)));
+        __m128d num = _mm_mul_pd(vscale, exp_sse2(_mm_mul_pd(vgamma, t)));
+        _mm_storeu_pd(y + i, _mm_div_pd(num, _mm_add_pd(one, exp_sse2(t))));
+    }
+    eplogis_scalar(x + i, y + i, n - i, scale, alpha, beta, gamma);
+}
+
+// =========================================================================================================
+// Run-time dispatch
+// =========================================================================================================
+
+static int simd_detect()
+{
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return 2;
+    if(__builtin_cpu_supports("sse2")) return 1;
+    return 0;
+}
+
+#else
+
+static int simd_detect()
+{
+    return 0;
+}
+
+#endif /* CSTAR_X86_SIMD */
+
+// Highest level the processor supports, detected on first use
+static int simd_supported()
+{
+    static const int level = simd_detect();
+    return level;
+}
+
+// Level in use: the supported one unless lowered by simd_set_level()
+static int& simd_active()
+{
+    static int level = simd_supported();
+    return level;
+}
+
+// =========================================================================================================
+// Public entry points
+// =========================================================================================================
+
+int cstar::simd_level()
+{
+    return simd_active();
+}
+
+int cstar::simd_set_level(int level)
+{
+    int old = simd_active();
+    int top = simd_supported();
+    simd_active() = level < 0 ? 0 : (level > top ? top : level);
+    return old;
+}
+
+void cstar::vexp(const double* x, double* y, int n)
+{
+#ifdef CSTAR_X86_SIMD
+    int level = simd_active();
+    if(level == 2) { exp_avx2(x, y, n); return; }
+    if(level == 1) { exp_sse2(x, y, n); return; }
+#endif
+    exp_scalar(x, y, n);
+}
+
+void cstar::vplogis(const double* x, double* y, int n, const double& mean, const double& sd)
+{
+#ifdef CSTAR_X86_SIMD
+    int level = simd_active();
+    if(level == 2) { plogis_avx2(x, y, n, mean, sd); return; }
+    if(level == 1) { plogis_sse2(x, y, n, mean, sd); return; }
+#endif
+    plogis_scalar(x, y, n, mean, sd);
+}
+
+void cstar::veplogis(const double* x, double* y, int n,
+                     const double& x1, const double& x2, const double& gamma)
+{
+    // Parameters of Thompson's (1994) exponential logistic, as in Selex::eplogis()
+    double t1    = 2.-4.*gamma+2.*gamma*gamma;
+    double t3    = 1.+2.*gamma-2*gamma*gamma;
+    double t5    = sqrt(1. + 4.*gamma - 4.*gamma*gamma);
+    double k1    = log(t1/(t3+t5));
+    double k2    = log(t1/(t3-t5));
+    double beta  = (k1*x2-x1*k2)/(k1-k2);
+    double alpha = k2/(x2-beta);
+    double scale = (1./(1.-gamma))*pow((1.-gamma)/gamma,gamma);
+
+#ifdef CSTAR_X86_SIMD
+    int level = simd_active();
+    if(level == 2) { eplogis_avx2(x, y, n, scale, alpha, beta, gamma); return; }
+    if(level == 1) { eplogis_sse2(x, y, n, scale, alpha, beta, gamma); return; }
+#endif
+    eplogis_scalar(x, y, n, scale, alpha, beta, gamma);
+}
+
+// =========================================================================================================
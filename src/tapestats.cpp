@@ -0,0 +1,177 @@
+/**
+*
+* \file tapestats.cpp
+* \brief Gradient-stack footprint per Cstar routine (-DCSTAR_TAPE_STATS)
+* \ingroup CSTAR
+*
+*  Each instrumented call records how far it moved the gradient stack
+*  pointer, the derivative-value buffer and the dvar_vector arena. The
+*  totals are printed to stderr at exit, largest first, to show which
+*  routines fill the gradient stack and how to size gradient_structure.
+*
+* \date 10/18/2026
+*
+ */
+
+#include "../include/cstar.h"
+
+#ifdef CSTAR_TAPE_STATS
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cstar {
+
+// =========================================================================================================
+
+namespace {
+
+std::mutex   g_tape_mutex;
+TapeCounter *g_tape_head = 0;
+
+// Depth of instrumented calls on this thread; only depth 0 is counted
+thread_local int t_tape_depth = 0;
+
+void tape_stats_at_exit()
+{
+    TapeStatsReport(std::cerr);
+}
+
+/*
+ * Where the tape stands now. These three read ADMB internals, and are the
+ * only place to change for another ADMB version.
+ */
+long long tape_stack_position()
+{
+    return (long long)(intptr_t)gradient_structure::GRAD_STACK1->ptr;
+}
+
+long long tape_buffer_offset()
+{
+    return (long long)gradient_structure::fp->offset;
+}
+
+long long tape_arena_offset()
+{
+    return (long long)gradient_structure::ARR_LIST1->get_last_offset();
+}
+
+struct TapeTotals
+{
+    long      calls;
+    long long bytes;
+    long long slots;
+    long long peak;
+    long      spills;
+};
+
+bool by_bytes(const std::pair<std::string,TapeTotals> &a, const std::pair<std::string,TapeTotals> &b)
+{
+    return a.second.bytes > b.second.bytes;
+}
+
+} // namespace
+
+
+TapeCounter::TapeCounter(const char *name_)
+    : name(name_), calls(0), bytes(0), slots(0), peak(0), spills(0), next(0)
+{
+    std::lock_guard<std::mutex> lock(g_tape_mutex);
+    if(!g_tape_head) std::atexit(tape_stats_at_exit);
+    next        = g_tape_head;
+    g_tape_head = this;
+}
+
+
+TapeScope::TapeScope(TapeCounter &counter)
+    : m_counter(counter), m_outer(false), m_stack(0), m_offset(0), m_slots(0)
+{
+    if(t_tape_depth++ > 0 || !gradient_structure::GRAD_STACK1) return;
+    m_outer  = true;
+    m_stack  = tape_stack_position();
+    m_offset = tape_buffer_offset();
+    m_slots  = tape_arena_offset();
+}
+
+
+TapeScope::~TapeScope()
+{
+    t_tape_depth--;
+    if(!m_outer) return;
+
+    long long dstack  = tape_stack_position() - m_stack;
+    long long doffset = tape_buffer_offset() - m_offset;
+    long long dslots  = (tape_arena_offset() - m_slots) / (long long)sizeof(double_and_int);
+
+    m_counter.calls++;
+    if(dslots > 0) m_counter.slots += dslots;
+
+    // The stack and the buffer start over when they are written to disk
+    if(dstack < 0 || doffset < 0)
+    {
+        m_counter.spills++;
+        return;
+    }
+    long long b = dstack + doffset;
+    m_counter.bytes += b;
+    long long p = m_counter.peak.load();
+    while(b > p && !m_counter.peak.compare_exchange_weak(p, b)) {}
+}
+
+
+// =========================================================================================================
+
+void TapeStatsReport(std::ostream &os)
+{
+    std::map<std::string,TapeTotals> totals;
+    {
+        std::lock_guard<std::mutex> lock(g_tape_mutex);
+        for(TapeCounter *c = g_tape_head; c; c = c->next)
+        {
+            if(c->calls.load() == 0) continue;
+            TapeTotals &t = totals[c->name];
+            t.calls  += c->calls.load();
+            t.bytes  += c->bytes.load();
+            t.slots  += c->slots.load();
+            t.peak    = std::max(t.peak, c->peak.load());
+            t.spills += c->spills.load();
+        }
+    }
+    if(totals.empty()) return;
+
+    std::vector<std::pair<std::string,TapeTotals> > rows(totals.begin(), totals.end());
+    std::sort(rows.begin(), rows.end(), by_bytes);
+
+    os << "\nCstar gradient-stack use (outermost calls)\n";
+    os << std::left  << std::setw(28) << "routine"
+       << std::right << std::setw(12) << "calls"
+       << std::setw(16) << "stack_bytes"
+       << std::setw(14) << "bytes/call"
+       << std::setw(14) << "peak_bytes"
+       << std::setw(14) << "var_slots"
+       << std::setw(8)  << "spills" << "\n";
+    for(size_t i = 0; i < rows.size(); i++)
+    {
+        const TapeTotals &t = rows[i].second;
+        long counted = t.calls - t.spills;
+        os << std::left  << std::setw(28) << rows[i].first
+           << std::right << std::setw(12) << t.calls
+           << std::setw(16) << t.bytes
+           << std::setw(14) << (counted > 0 ? t.bytes / counted : 0)
+           << std::setw(14) << t.peak
+           << std::setw(14) << t.slots
+           << std::setw(8)  << t.spills << "\n";
+    }
+}
+
+} // namespace cstar
+
+#endif /* CSTAR_TAPE_STATS */